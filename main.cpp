@@ -1,26 +1,147 @@
+#include <algorithm>
 #include <array>
+#include <cctype>
+#include <cfloat>
 #include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
 #include <memory>
+#include <random>
 #include <string_view>
+#include <type_traits>
 
+#include <ConstraintCapture.h>
+#include <FlowField.h>
+#include <PerfCounters.h>
 #include <RVOSimulator.h>
 #include <SDL.h>
 #include <SDL_render.h>
+#include <Trace.h>
 #include <imgui.h>
 #include <imgui_impl_sdl.h>
 #include <imgui_sdl.h>
 
+#include "scenario.h"
+#include "trajectory.h"
+
 #if __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
+/*
+ * Durations of the last frames or steps with the time they were taken, to
+ * summarize the tail latency over a window of recent seconds.
+ */
+class TimingHistory
+{
+public:
+  struct summary_t
+  {
+    size_t count{ 0 };
+    float p50{ 0.0f };
+    float p95{ 0.0f };
+    float p99{ 0.0f };
+    float max{ 0.0f };
+  };
+
+  static constexpr size_t capacity = 16384;
+  static constexpr size_t histogram_size = 32;
+
+  void add(float milliseconds)
+  {
+    values[offset] = milliseconds;
+    times[offset] = std::chrono::steady_clock::now();
+    offset = (offset + 1) % capacity;
+    count = std::min(count + 1, capacity);
+  }
+
+  /* Collect the durations of the last seconds, oldest first. */
+  void window(float seconds, std::vector<float>& out) const
+  {
+    out.clear();
+    const auto start =
+      std::chrono::steady_clock::now() -
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<float>(seconds));
+    size_t first = count;
+    while (first > 0 && times[(offset + capacity - first) % capacity] < start) {
+      --first;
+    }
+    for (size_t i = first; i > 0; --i) {
+      out.push_back(values[(offset + capacity - i) % capacity]);
+    }
+  }
+
+  static summary_t summarize(const std::vector<float>& values)
+  {
+    summary_t summary;
+    summary.count = values.size();
+    if (values.empty()) {
+      return summary;
+    }
+    std::vector<float> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](float p) {
+      return sorted[std::min(sorted.size() - 1,
+                             static_cast<size_t>(p * sorted.size()))];
+    };
+    summary.p50 = percentile(0.50f);
+    summary.p95 = percentile(0.95f);
+    summary.p99 = percentile(0.99f);
+    summary.max = sorted.back();
+    return summary;
+  }
+
+  /* Count the durations in equal bins from zero to the maximum. */
+  static std::array<float, histogram_size> histogram(
+    const std::vector<float>& values,
+    float max)
+  {
+    std::array<float, histogram_size> bins{};
+    for (const auto value : values) {
+      const size_t bin =
+        max > 0.0f ? static_cast<size_t>(value / max * histogram_size) : 0;
+      ++bins[std::min(bin, histogram_size - 1)];
+    }
+    return bins;
+  }
+
+private:
+  std::array<float, capacity> values{};
+  std::array<std::chrono::steady_clock::time_point, capacity> times{};
+  size_t offset{ 0 };
+  size_t count{ 0 };
+};
+
+/* The parts of the memory footprint of a simulation, in bytes. */
+static std::array<std::pair<const char*, size_t>, 11>
+memory_parts(const RVO::MemoryStats& stats)
+{
+  return { {
+    { "Agents", stats.agents },
+    { "Agent neighbors", stats.agentNeighbors },
+    { "Obstacle neighbors", stats.obstacleNeighbors },
+    { "ORCA lines", stats.orcaLines },
+    { "Agent profiles", stats.agentProfiles },
+    { "Agent tree", stats.agentTree },
+    { "Obstacle tree", stats.obstacleTree },
+    { "Obstacles", stats.obstacles },
+    { "Split obstacles", stats.splitObstacles },
+    { "Slots", stats.slots },
+    { "Scratch", stats.scratch },
+  } };
+}
+
 struct Simulation
 {
   enum configuration_t
   {
     CIRCLE,
     DEADLOCK,
+    STREAM,
+    SCENARIO,
 
     _CONFIGURATION_COUNT,
   };
@@ -28,13 +149,38 @@ struct Simulation
     configuration_strings{
       "Circle",
       "Deadlock",
+      "Stream",
+      "Scenario",
+    };
+  enum guidance_t
+  {
+    STRAIGHT_LINE,
+    FLOW_FIELD,
+
+    _GUIDANCE_COUNT,
+  };
+  static constexpr std::array<std::string_view, _GUIDANCE_COUNT>
+    guidance_strings{
+      "Straight Line",
+      "Flow Field",
     };
+  /*
+   * Trajectories store the raw bytes of the options, so the version must be
+   * bumped whenever a field is added, removed, reordered or retyped.
+   */
+  static constexpr uint32_t options_version{ 1 };
   struct options_t
   {
     configuration_t configuration{ CIRCLE };
+    guidance_t guidance{ STRAIGHT_LINE };
     bool run_simulation{ false };
     bool show_goal{ false };
     bool show_velocity{ true };
+    bool batch_neighbor_queries{ true };
+    bool warm_start_lp{ false };
+    bool random_lp_order{ false };
+    bool work_stealing{ false };
+    int numThreads{ 0 };
     float time_scale{ 10.0f };
     float neighborDist{ 15.0f };
     int maxNeighbors{ 10 };
@@ -43,12 +189,54 @@ struct Simulation
     float radius{ 1.5f };
     float maxSpeed{ 10.0f };
     int numAgents{ 250 };
+    float spawnRate{ 10.0f };
     float circleRadius{ 200 };
+    float flowFieldCellSize{ 5.0f };
   };
   Simulation() = default;
 
+  /*
+   * Whether two sets of options produce the same initial scene. The agent
+   * parameters that apply live are not part of the scene, except the radius
+   * which places the agents of the deadlock.
+   */
+  static bool same_scene(const options_t& a, const options_t& b)
+  {
+    return a.configuration == b.configuration && a.guidance == b.guidance &&
+           a.radius == b.radius && a.numAgents == b.numAgents &&
+           a.spawnRate == b.spawnRate &&
+           a.circleRadius == b.circleRadius &&
+           a.flowFieldCellSize == b.flowFieldCellSize;
+  }
+
   void initialize(const options_t& options)
   {
+    selected_agent = RVO::RVO_ERROR;
+    reset_counters();
+
+    /*
+     * Resetting an unchanged scene restores the snapshot taken after the last
+     * full initialization instead of adding agents and processing obstacles.
+     * The goals of the agents belong to the snapshot, since the stream and
+     * the agent count change the crowd afterwards. The flow fields those
+     * changes left are updated for the restored goals.
+     */
+    if (simulator && !initial_state.empty() &&
+        initial_obstacles == obstacles.size() &&
+        same_scene(options, initial_options) &&
+        simulator->loadState(initial_state)) {
+      goals = initial_goals;
+      update_flow_fields(options);
+      apply_parameters(options);
+      simulator->setNeighborQueryBatching(options.batch_neighbor_queries);
+      simulator->setLinearProgramWarmStart(options.warm_start_lp);
+      simulator->setLinearProgramRandomOrder(options.random_lp_order);
+      simulator->setWorkStealing(options.work_stealing);
+      simulator->setNumThreads(options.numThreads);
+      set_preferred_velocities();
+      return;
+    }
+
     simulator = std::make_unique<RVO::RVOSimulator>();
     /* Specify the default parameters for agents that are subsequently added. */
     simulator->setAgentDefaults(options.neighborDist,
@@ -57,11 +245,19 @@ struct Simulation
                                 options.timeHorizonObst,
                                 options.radius,
                                 options.maxSpeed);
-
+    simulator->setNeighborQueryBatching(options.batch_neighbor_queries);
+    simulator->setLinearProgramWarmStart(options.warm_start_lp);
+    simulator->setLinearProgramRandomOrder(options.random_lp_order);
+    simulator->setWorkStealing(options.work_stealing);
+    simulator->setNumThreads(options.numThreads);
+
+    if (options.configuration == SCENARIO) {
+      add_scenario_obstacles();
+    }
     for (const auto& obstacle : obstacles) {
       simulator->addObstacle(obstacle);
     }
-    if (!obstacles.empty()) {
+    if (!obstacles.empty() || scenario_obstacles(options) > 0) {
       simulator->processObstacles();
     }
 
@@ -72,13 +268,7 @@ struct Simulation
     goals.clear();
     if (options.configuration == CIRCLE) {
       goals.reserve(options.numAgents);
-      for (size_t i = 0; i < options.numAgents; ++i) {
-        simulator->addAgent(
-          options.circleRadius *
-          RVO::Vector2(std::cos(i * 2 * M_PI / options.numAgents),
-                       std::sin(i * 2 * M_PI / options.numAgents)));
-        goals.push_back(-simulator->getAgentPosition(i));
-      }
+      add_circle_agents(options);
     } else if (options.configuration == DEADLOCK) {
       // Phalanx moving right
       for (uint8_t i = 0; i < 2; ++i) {
@@ -107,41 +297,590 @@ struct Simulation
       // Agent going down who will disrupt the collinear deadlock
       simulator->addAgent(RVO::Vector2(-20 * options.radius, 100));
       goals.emplace_back(-20 * options.radius, -100);
+
+    } else if (options.configuration == SCENARIO) {
+      add_scenario_agents();
     }
 
+    build_flow_fields(options);
+    simulator->saveState(initial_state);
+    initial_goals = goals;
+    initial_options = options;
+    initial_obstacles = obstacles.size();
     set_preferred_velocities();
   }
 
+  /* Restart the stream spawns and the counters of a new run. */
+  void reset_counters()
+  {
+    spawn_rng.seed(0);
+    spawn_budget = 0.0f;
+    despawned_agents = 0;
+    flow_rate = 0.0f;
+    solver_totals = {};
+  }
+
+  /*
+   * Add the agents of the circle that are missing, keeping the others. An
+   * empty circle takes the initial layout. Agents added to a running crowd
+   * take free places instead, so that they do not overlap the agents already
+   * there.
+   */
+  void add_circle_agents(const options_t& options)
+  {
+    const auto num_agents = static_cast<size_t>(options.numAgents);
+    if (simulator->getNumAgents() == 0) {
+      for (size_t i = 0; i < num_agents; ++i) {
+        simulator->addAgent(
+          options.circleRadius *
+          RVO::Vector2(std::cos(i * 2 * M_PI / options.numAgents),
+                       std::sin(i * 2 * M_PI / options.numAgents)));
+        goals.push_back(-simulator->getAgentPosition(i));
+      }
+      return;
+    }
+
+    /*
+     * Places whose chord is at least a diameter do not overlap each other.
+     * When the circle is full, the search continues on concentric circles one
+     * diameter further out.
+     */
+    std::vector<RVO::Vector2> spawns;
+    std::vector<size_t> nearest;
+    for (float radius = options.circleRadius;
+         simulator->getNumAgents() + spawns.size() < num_agents;
+         radius += 2 * options.radius) {
+      const float spacing =
+        2 * std::asin(std::min(options.radius / radius, 1.0f));
+      const size_t places = std::max<size_t>(
+        static_cast<size_t>(2 * M_PI / std::max(spacing, FLT_EPSILON)), 1);
+      for (size_t i = 0; i < places; ++i) {
+        if (simulator->getNumAgents() + spawns.size() >= num_agents) {
+          break;
+        }
+        const auto position =
+          radius * RVO::Vector2(std::cos(i * 2 * M_PI / places),
+                                std::sin(i * 2 * M_PI / places));
+        simulator->queryNearestAgents(
+          position, 1, nearest, 2 * options.radius);
+        if (nearest.empty()) {
+          spawns.push_back(position);
+        }
+      }
+    }
+    /* The agents are added after the queries, so the tree is built once. */
+    for (const auto& position : spawns) {
+      simulator->addAgent(position);
+      goals.push_back(-position);
+    }
+  }
+
+  /*
+   * Load a scenario file for the scenario configuration. The snapshot of the
+   * previous scene no longer applies.
+   */
+  bool load_scenario(const char* path)
+  {
+    initial_state.clear();
+    return scenario.open(path);
+  }
+
+  size_t scenario_obstacles(const options_t& options) const
+  {
+    return options.configuration == SCENARIO ? scenario.obstacles_size() : 0;
+  }
+
+  void add_scenario_obstacles()
+  {
+    std::vector<RVO::Vector2> vertices;
+    for (size_t i = 0; i < scenario.obstacles_size(); ++i) {
+      vertices.clear();
+      for (size_t j = scenario.obstacle_begin(i); j < scenario.obstacle_end(i);
+           ++j) {
+        const auto& vertex = scenario.vertex(j);
+        vertices.emplace_back(vertex.position[0], vertex.position[1]);
+      }
+      simulator->addObstacle(vertices);
+    }
+  }
+
+  /*
+   * Add the agents of the scenario with their own profiles. Agents without a
+   * profile take the agent defaults and follow the parameter sliders.
+   */
+  void add_scenario_agents()
+  {
+    std::vector<size_t> profiles;
+    profiles.reserve(scenario.profiles_size());
+    for (size_t i = 0; i < scenario.profiles_size(); ++i) {
+      const auto& profile = scenario.profile(i);
+      profiles.push_back(simulator->addAgentProfile(profile.neighbor_dist,
+                                                    profile.max_neighbors,
+                                                    profile.time_horizon,
+                                                    profile.time_horizon_obst,
+                                                    profile.radius,
+                                                    profile.max_speed));
+    }
+    goals.reserve(scenario.agents_size());
+    for (size_t i = 0; i < scenario.agents_size(); ++i) {
+      const auto& agent = scenario.agent(i);
+      const RVO::Vector2 position(agent.position[0], agent.position[1]);
+      if (agent.profile == Scenario::default_profile) {
+        simulator->addAgent(position);
+      } else {
+        simulator->addAgent(position, profiles[agent.profile]);
+      }
+      goals.emplace_back(agent.goal[0], agent.goal[1]);
+    }
+  }
+
+  /* Apply the agent parameters to all agents without resetting the crowd. */
+  void apply_parameters(const options_t& options)
+  {
+    simulator->setAgentProfileParameters(simulator->getDefaultAgentProfile(),
+                                         options.neighborDist,
+                                         options.maxNeighbors,
+                                         options.timeHorizon,
+                                         options.timeHorizonObst,
+                                         options.radius,
+                                         options.maxSpeed);
+  }
+
+  /*
+   * The stream runs between two doors on the circle, each a source of agents
+   * heading to the other and a sink for agents arriving from it.
+   */
+  static RVO::Vector2 stream_door(const options_t& options, bool right)
+  {
+    return RVO::Vector2(right ? options.circleRadius : -options.circleRadius,
+                        0.0f);
+  }
+
+  static float stream_door_width(const options_t& options)
+  {
+    return 0.25f * options.circleRadius;
+  }
+
+  /*
+   * Remove the agents that reached their sink, then spawn agents at the
+   * sources at the spawn rate while the pool has room.
+   */
+  void stream(float dt, const options_t& options)
+  {
+    size_t despawned = 0;
+    const float door_width = stream_door_width(options);
+    /*
+     * The agents that stay and may block a spawn are gathered on the way, so
+     * that spawning does not query the agent tree, which the step and the
+     * removals left to be rebuilt.
+     */
+    const float reach = door_width + 2 * options.radius;
+    const auto left_door = stream_door(options, false);
+    const auto right_door = stream_door(options, true);
+    std::vector<RVO::Vector2> blockers;
+    for (size_t i = simulator->getNumAgents(); i-- > 0;) {
+      const auto position = simulator->getAgentPosition(i);
+      if (RVO::absSq(goals[i] - position) >= door_width * door_width) {
+        if (RVO::absSq(left_door - position) < reach * reach ||
+            RVO::absSq(right_door - position) < reach * reach) {
+          blockers.push_back(position);
+        }
+      } else {
+        /* The simulator moves the last agent into the removed slot. */
+        simulator->removeAgent(i);
+        goals[i] = goals.back();
+        goals.pop_back();
+        if (!agent_flow_fields.empty()) {
+          agent_flow_fields[i] = agent_flow_fields.back();
+          agent_flow_fields.pop_back();
+        }
+        ++despawned;
+      }
+    }
+    if (despawned > 0) {
+      selected_agent = RVO::RVO_ERROR;
+    }
+    despawned_agents += despawned;
+    flow_rate = dt > 0.0f ? despawned / dt : 0.0f;
+
+    /*
+     * Spawns blocked by agents still at the door or by earlier spawns wait for
+     * the next step.
+     */
+    spawn_budget = std::min(spawn_budget + options.spawnRate * dt,
+                            std::max(options.spawnRate, 1.0f));
+    std::uniform_real_distribution<float> offset(-door_width, door_width);
+    std::vector<std::pair<RVO::Vector2, bool>> spawns;
+    while (spawn_budget >= 1.0f &&
+           simulator->getNumAgents() + spawns.size() <
+             static_cast<size_t>(options.numAgents)) {
+      const bool right = (spawn_rng() & 1) != 0;
+      const auto position =
+        stream_door(options, right) + RVO::Vector2(0.0f, offset(spawn_rng));
+      const bool blocked =
+        std::any_of(blockers.begin(), blockers.end(), [&](const auto& blocker) {
+          return RVO::absSq(blocker - position) <
+                 4 * options.radius * options.radius;
+        });
+      if (blocked) {
+        break;
+      }
+      blockers.push_back(position);
+      spawns.emplace_back(position, right);
+      spawn_budget -= 1.0f;
+    }
+    for (const auto& [position, right] : spawns) {
+      simulator->addAgent(position);
+      goals.push_back(stream_door(options, !right));
+      if (!flow_fields.empty()) {
+        agent_flow_fields.push_back(flow_field_by_goal.at(
+          std::make_pair(goals.back().x(), goals.back().y())));
+      }
+    }
+  }
+
+  /* Grow or shrink the circle to the requested number of agents. */
+  void resize_agents(const options_t& options)
+  {
+    if (options.configuration != CIRCLE) {
+      return;
+    }
+    while (simulator->getNumAgents() >
+           static_cast<size_t>(options.numAgents)) {
+      /* Removing the last agent keeps the numbers of the others. */
+      simulator->removeAgent(simulator->getNumAgents() - 1);
+      goals.pop_back();
+    }
+    if (selected_agent >= simulator->getNumAgents()) {
+      selected_agent = RVO::RVO_ERROR;
+    }
+    add_circle_agents(options);
+    update_flow_fields(options);
+    set_preferred_velocities();
+  }
+
+  /* The stream spawns agents later, so its fields cover both doors. */
+  std::vector<RVO::Vector2> flow_field_targets(const options_t& options) const
+  {
+    std::vector<RVO::Vector2> targets = goals;
+    if (options.configuration == STREAM) {
+      targets.push_back(stream_door(options, false));
+      targets.push_back(stream_door(options, true));
+    }
+    return targets;
+  }
+
+  /*
+   * Compute one flow field per distinct goal, covering the agents, goals and
+   * obstacles. Without obstacles the straight line is already optimal.
+   */
+  void build_flow_fields(const options_t& options)
+  {
+    flow_fields.clear();
+    agent_flow_fields.clear();
+    flow_field_by_goal.clear();
+
+    const auto targets = flow_field_targets(options);
+    if (options.guidance != FLOW_FIELD ||
+        (obstacles.empty() && scenario_obstacles(options) == 0) ||
+        targets.empty()) {
+      return;
+    }
+
+    RVO::Vector2 min_corner = targets.front();
+    RVO::Vector2 max_corner = targets.front();
+    auto extend = [&](const RVO::Vector2& point) {
+      min_corner = RVO::Vector2(std::min(min_corner.x(), point.x()),
+                                std::min(min_corner.y(), point.y()));
+      max_corner = RVO::Vector2(std::max(max_corner.x(), point.x()),
+                                std::max(max_corner.y(), point.y()));
+    };
+    for (uint32_t i = 0; i < simulator->getNumAgents(); ++i) {
+      extend(simulator->getAgentPosition(i));
+    }
+    for (const auto& target : targets) {
+      extend(target + RVO::Vector2(0.0f, stream_door_width(options)));
+      extend(target - RVO::Vector2(0.0f, stream_door_width(options)));
+    }
+    for (const auto& obstacle : obstacles) {
+      for (const auto& vertex : obstacle) {
+        extend(vertex);
+      }
+    }
+    if (scenario_obstacles(options) > 0) {
+      for (size_t i = 0; i < scenario.vertices_size(); ++i) {
+        const auto& vertex = scenario.vertex(i);
+        extend(RVO::Vector2(vertex.position[0], vertex.position[1]));
+      }
+    }
+    const float margin = 2 * options.flowFieldCellSize + options.radius;
+    flow_field_min = min_corner - RVO::Vector2(margin, margin);
+    flow_field_max = max_corner + RVO::Vector2(margin, margin);
+
+    for (const auto& target : targets) {
+      auto [it, inserted] = flow_field_by_goal.emplace(
+        std::make_pair(target.x(), target.y()), flow_fields.size());
+      if (inserted) {
+        flow_fields.emplace_back(simulator.get(),
+                                 target,
+                                 flow_field_min,
+                                 flow_field_max,
+                                 options.flowFieldCellSize,
+                                 options.radius);
+      }
+    }
+    assign_flow_fields();
+  }
+
+  /*
+   * Update the flow fields after agents were added or removed. Only the
+   * fields of new goals are built, and the fields that no goal uses any more
+   * are dropped. All fields are rebuilt when an agent or a goal left their
+   * bounds.
+   */
+  void update_flow_fields(const options_t& options)
+  {
+    if (flow_fields.empty()) {
+      build_flow_fields(options);
+      return;
+    }
+
+    const auto targets = flow_field_targets(options);
+    const float margin = 2 * options.flowFieldCellSize + options.radius;
+    const RVO::Vector2 door(0.0f, stream_door_width(options));
+    auto covered = [&](const RVO::Vector2& point) {
+      return point.x() >= flow_field_min.x() + margin &&
+             point.y() >= flow_field_min.y() + margin &&
+             point.x() <= flow_field_max.x() - margin &&
+             point.y() <= flow_field_max.y() - margin;
+    };
+    for (uint32_t i = 0; i < simulator->getNumAgents(); ++i) {
+      if (!covered(simulator->getAgentPosition(i))) {
+        build_flow_fields(options);
+        return;
+      }
+    }
+    for (const auto& target : targets) {
+      if (!covered(target + door) || !covered(target - door)) {
+        build_flow_fields(options);
+        return;
+      }
+    }
+
+    std::vector<RVO::FlowField> kept;
+    std::map<std::pair<float, float>, size_t> kept_by_goal;
+    for (const auto& target : targets) {
+      const auto key = std::make_pair(target.x(), target.y());
+      if (!kept_by_goal.emplace(key, kept.size()).second) {
+        continue;
+      }
+      const auto it = flow_field_by_goal.find(key);
+      if (it != flow_field_by_goal.end()) {
+        kept.push_back(std::move(flow_fields[it->second]));
+      } else {
+        kept.emplace_back(simulator.get(),
+                          target,
+                          flow_field_min,
+                          flow_field_max,
+                          options.flowFieldCellSize,
+                          options.radius);
+      }
+    }
+    flow_fields = std::move(kept);
+    flow_field_by_goal = std::move(kept_by_goal);
+    assign_flow_fields();
+  }
+
+  void assign_flow_fields()
+  {
+    agent_flow_fields.clear();
+    agent_flow_fields.reserve(goals.size());
+    for (const auto& goal : goals) {
+      agent_flow_fields.push_back(
+        flow_field_by_goal.at(std::make_pair(goal.x(), goal.y())));
+    }
+  }
+
   void set_preferred_velocities()
   {
+    RVO_TRACE_SCOPE("set_preferred_velocities");
+
     for (int i = 0; i < static_cast<int>(simulator->getNumAgents()); ++i) {
-      RVO::Vector2 goalVector = goals[i] - simulator->getAgentPosition(i);
+      const auto& position = simulator->getAgentPosition(i);
+      RVO::Vector2 goalVector;
+      if (agent_flow_fields.empty()) {
+        goalVector = goals[i] - position;
+      } else {
+        const auto& flow_field = flow_fields[agent_flow_fields[i]];
+        goalVector =
+          flow_field.getDirection(position) * flow_field.getDistance(position);
+      }
 
       simulator->setAgentPrefVelocity(i, goalVector);
     }
   }
 
-  void step(float dt)
+  const RVO::Vector2& waypoint(size_t agent) const
+  {
+    if (agent_flow_fields.empty()) {
+      return goals[agent];
+    }
+    return flow_fields[agent_flow_fields[agent]].getWaypoint(
+      simulator->getAgentPosition(agent));
+  }
+
+  void step(float dt, const options_t& options)
   {
     /* Specify the global time step of the simulation. */
     simulator->setTimeStep(dt);
+    auto start = std::chrono::steady_clock::now();
     simulator->doStep();
+    auto end = std::chrono::steady_clock::now();
+    const auto stats = simulator->getSolverStats();
+    solver_totals.agentLines += stats.agentLines;
+    solver_totals.agents += stats.agents;
+    solver_totals.collidingAgents += stats.collidingAgents;
+    solver_totals.coveredObstacles += stats.coveredObstacles;
+    solver_totals.linearProgram1Calls += stats.linearProgram1Calls;
+    solver_totals.linearProgram3Calls += stats.linearProgram3Calls;
+    solver_totals.obstacleLines += stats.obstacleLines;
+    if (options.configuration == STREAM) {
+      stream(dt, options);
+    }
+    recorder.record(*simulator);
+
+    step_times.add(std::chrono::duration<float, std::milli>(end - start).count());
+    agent_counts[stats_offset] = simulator->getNumAgents();
+    flow_rates[stats_offset] = flow_rate;
+    stats_offset = (stats_offset + 1) % stats_size;
   }
 
-  void commit_obstacle()
+  bool start_recording(const char* path, const options_t& options)
+  {
+    static_assert(std::is_trivially_copyable_v<options_t>);
+    if (!recorder.open(path, &options, sizeof(options), options_version)) {
+      return false;
+    }
+    recorder.record(*simulator);
+    return true;
+  }
+
+  void stop_recording() { recorder.close(); }
+
+  void commit_obstacle(const options_t& options)
   {
     if (staging_obstacle.size() > 2) {
       simulator->addObstacle(staging_obstacle);
       simulator->processObstacles();
       obstacles.emplace_back(staging_obstacle);
+      build_flow_fields(options);
     }
     staging_obstacle.clear();
   }
 
+  void select_agent(const RVO::Vector2& point, float max_distance)
+  {
+    std::vector<size_t> nearest;
+    simulator->queryNearestAgents(point, 1, nearest, max_distance);
+    selected_agent = nearest.empty() ? RVO::RVO_ERROR : nearest.front();
+  }
+
   std::unique_ptr<RVO::RVOSimulator> simulator;
+  size_t selected_agent{ RVO::RVO_ERROR };
   std::vector<RVO::Vector2> goals;
+  std::vector<RVO::FlowField> flow_fields;
+  std::vector<size_t> agent_flow_fields;
   std::vector<RVO::Vector2> staging_obstacle;
   std::vector<std::vector<RVO::Vector2>> obstacles;
+  std::vector<char> initial_state;
+  std::vector<RVO::Vector2> initial_goals;
+  options_t initial_options;
+  size_t initial_obstacles{ 0 };
+  TrajectoryWriter recorder;
+  ScenarioReader scenario;
+
+  std::map<std::pair<float, float>, size_t> flow_field_by_goal;
+  /* The bounds of the flow fields, which include a margin. */
+  RVO::Vector2 flow_field_min;
+  RVO::Vector2 flow_field_max;
+  std::mt19937 spawn_rng;
+  float spawn_budget{ 0.0f };
+  uint64_t despawned_agents{ 0 };
+  float flow_rate{ 0.0f };
+
+  TimingHistory step_times;
+  /* Solver counters summed over the steps since the last initialization. */
+  RVO::SolverStats solver_totals;
+
+  /* The last steps, oldest first from stats_offset, for the live plots. */
+  static constexpr size_t stats_size = 256;
+  std::array<float, stats_size> agent_counts{};
+  std::array<float, stats_size> flow_rates{};
+  size_t stats_offset{ 0 };
+};
+
+struct Replay
+{
+  bool open(const char* path)
+  {
+    if (!reader.open(path)) {
+      return false;
+    }
+    if (reader.frames() == 0) {
+      std::printf("Trajectory file %s has no frames\n", path);
+      reader.close();
+      return false;
+    }
+    if (reader.dropped_frames() > 0) {
+      std::printf("Trajectory file %s misses %u steps the recorder dropped\n",
+                  path,
+                  reader.dropped_frames());
+    }
+    Simulation::options_t options;
+    if (reader.options_version() == Simulation::options_version &&
+        reader.options_size() == sizeof(options)) {
+      std::memcpy(&options, reader.options(), sizeof(options));
+      radius = options.radius;
+    } else {
+      std::printf("Trajectory file %s stores options of version %u, skipped "
+                  "for the defaults of version %u\n",
+                  path,
+                  reader.options_version(),
+                  Simulation::options_version);
+    }
+    playing = false;
+    seek(0);
+    return true;
+  }
+
+  void close() { reader.close(); }
+
+  bool is_open() const { return reader.is_open(); }
+
+  void seek(uint64_t to)
+  {
+    frame = std::min(to, reader.frames() - 1);
+    time = reader.header(frame).time;
+  }
+
+  /* Advance the playback by dt seconds of recorded time. */
+  void advance(float dt)
+  {
+    if (!playing) {
+      return;
+    }
+    time += dt;
+    frame = reader.find(time);
+    if (frame + 1 == reader.frames()) {
+      playing = false;
+    }
+  }
+
+  TrajectoryReader reader;
+  uint64_t frame{ 0 };
+  double time{ 0 };
+  bool playing{ false };
+  float radius{ 1.5f };
 };
 
 struct Renderer
@@ -154,6 +893,13 @@ struct Renderer
     uint8_t background_color[3] = { 0x37, 0x47, 0x4F };
     uint8_t goal_color[3] = { 0x00, 0x00, 0x00 };
     uint8_t velocity_color[3] = { 0x23, 0xC7, 0xAC };
+    uint8_t selection_color[3] = { 0xFF, 0xC1, 0x07 };
+    uint8_t nearby_color[3] = { 0xFF, 0x8A, 0x65 };
+    char trajectory_path[256] = "trajectory.rvot";
+    char replay_path[256] = "trajectory.rvot";
+    char scenario_path[256] = "scenario.txt";
+    char trace_path[256] = "trace.json";
+    float timing_window{ 10.0f };
   };
 
 public:
@@ -245,8 +991,13 @@ public:
 
   void draw(float dt,
             Simulation& simulation,
-            Simulation::options_t& simulation_options)
+            Simulation::options_t& simulation_options,
+            Replay& replay)
   {
+    const auto start = std::chrono::steady_clock::now();
+    frame_times.add(dt * 1000.0f);
+
+    RVO_TRACE_BEGIN(build_ui_scope, "build_ui");
     ImGui_ImplSDL2_NewFrame(window);
     ImGui::NewFrame();
 
@@ -256,6 +1007,7 @@ public:
                 "\tSpacebar: Pause/Continue Simulation.\n"
                 "\tBackspace: Reset Simulation.\n"
                 "Mouse controls:\n"
+                "\tClick to select agent\n"
                 "\tDouble click to add obstacle vertex\n"
                 "\tRight click to finish obstacle");
 
@@ -268,17 +1020,30 @@ public:
       "Offset", &options.offset_x, -offset_max, offset_max + 1);
     ImGui::SliderFloat(
       "Time Scale", &simulation_options.time_scale, 0.01, 100, "%.3f", 2.0f);
-    ImGui::SliderFloat(
+    bool parameters_changed = false;
+    parameters_changed |= ImGui::SliderFloat(
       "Neighbor Distance (m)", &simulation_options.neighborDist, 0, 50);
-    ImGui::SliderInt("Max Neighbors", &simulation_options.maxNeighbors, 0, 50);
-    ImGui::SliderFloat(
+    parameters_changed |= ImGui::SliderInt(
+      "Max Neighbors", &simulation_options.maxNeighbors, 0, 50);
+    parameters_changed |= ImGui::SliderFloat(
       "Tau for other agents (s)", &simulation_options.timeHorizon, 0, 50);
-    ImGui::SliderFloat(
+    parameters_changed |= ImGui::SliderFloat(
       "Tau for Obstacles (s)", &simulation_options.timeHorizonObst, 0, 50);
-    ImGui::SliderFloat("Agent Radius (m)", &simulation_options.radius, 0, 10);
-    ImGui::SliderFloat(
+    parameters_changed |= ImGui::SliderFloat(
+      "Agent Radius (m)", &simulation_options.radius, 0, 10);
+    parameters_changed |= ImGui::SliderFloat(
       "Agent Max Speed (m/s)", &simulation_options.maxSpeed, 0, 100);
-    ImGui::SliderInt("Number of Agents", &simulation_options.numAgents, 0, 500);
+    if (parameters_changed) {
+      simulation.apply_parameters(simulation_options);
+    }
+    if (ImGui::SliderInt(
+          "Number of Agents", &simulation_options.numAgents, 0, 500)) {
+      /* Typed values are not clamped by the slider. */
+      simulation_options.numAgents = std::max(simulation_options.numAgents, 0);
+      simulation.resize_agents(simulation_options);
+    }
+    ImGui::SliderFloat(
+      "Spawn Rate (agents/s)", &simulation_options.spawnRate, 0, 100);
     ImGui::SliderFloat(
       "Radius of Circle (m)", &simulation_options.circleRadius, 0, 1000);
 
@@ -286,6 +1051,24 @@ public:
     ImGui::Checkbox("Show Preferred velocity",
                     &simulation_options.show_velocity);
     ImGui::Checkbox("Run Simulation", &simulation_options.run_simulation);
+    if (ImGui::Checkbox("Batch Neighbor Queries",
+                        &simulation_options.batch_neighbor_queries)) {
+      simulation.simulator->setNeighborQueryBatching(
+        simulation_options.batch_neighbor_queries);
+    }
+    if (ImGui::Checkbox("Warm Start Linear Programs",
+                        &simulation_options.warm_start_lp)) {
+      simulation.simulator->setLinearProgramWarmStart(
+        simulation_options.warm_start_lp);
+    }
+    if (ImGui::Checkbox("Random Linear Program Order",
+                        &simulation_options.random_lp_order)) {
+      simulation.simulator->setLinearProgramRandomOrder(
+        simulation_options.random_lp_order);
+    }
+    if (ImGui::Checkbox("Work Stealing", &simulation_options.work_stealing)) {
+      simulation.simulator->setWorkStealing(simulation_options.work_stealing);
+    }
 
     auto item_current =
       Simulation::configuration_strings[simulation_options.configuration];
@@ -304,16 +1087,226 @@ public:
       ImGui::EndCombo();
     }
 
+    auto guidance_current =
+      Simulation::guidance_strings[simulation_options.guidance];
+    if (ImGui::BeginCombo("Guidance", guidance_current.data())) {
+      for (int n = 0; n < Simulation::guidance_strings.size(); n++) {
+        bool is_selected = (guidance_current == Simulation::guidance_strings[n]);
+        if (ImGui::Selectable(Simulation::guidance_strings[n].data(),
+                              is_selected)) {
+          simulation_options.guidance = static_cast<Simulation::guidance_t>(n);
+          simulation.build_flow_fields(simulation_options);
+        }
+        if (is_selected)
+          ImGui::SetItemDefaultFocus();
+      }
+      ImGui::EndCombo();
+    }
+    ImGui::SliderFloat(
+      "Flow Field Cell Size (m)", &simulation_options.flowFieldCellSize, 1, 50);
+
+    /* Live plots of the last steps, with the latest value as overlay. */
+    auto plot = [&](const char* label, const float* values, const char* format) {
+      const size_t latest =
+        (simulation.stats_offset + Simulation::stats_size - 1) %
+        Simulation::stats_size;
+      char overlay[32];
+      std::snprintf(overlay, sizeof(overlay), format, values[latest]);
+      ImGui::PlotLines(label,
+                       values,
+                       Simulation::stats_size,
+                       simulation.stats_offset,
+                       overlay,
+                       0.0f,
+                       FLT_MAX,
+                       ImVec2(0, 40));
+    };
+    plot("Agents", simulation.agent_counts.data(), "%.0f");
+    if (simulation_options.configuration == Simulation::STREAM) {
+      plot("Flow Rate (agents/s)", simulation.flow_rates.data(), "%.1f/s");
+      ImGui::Text("Despawned agents: %llu",
+                  static_cast<unsigned long long>(simulation.despawned_agents));
+    }
+
+    /*
+     * Durations over the last seconds with their distribution, as hitches
+     * show in the tail rather than in the latest value. The render time is
+     * that of the previous frame, up to presenting it.
+     */
+    if (ImGui::CollapsingHeader("Timing", ImGuiTreeNodeFlags_DefaultOpen)) {
+      ImGui::SliderFloat("Window (s)", &options.timing_window, 1, 60);
+      std::vector<float> values;
+      auto timing = [&](const char* label, const TimingHistory& history) {
+        history.window(options.timing_window, values);
+        const auto summary = TimingHistory::summarize(values);
+        const auto bins = TimingHistory::histogram(values, summary.max);
+        char overlay[32];
+        ImGui::PushID(label);
+        ImGui::Text("%s: p50 %.2f, p95 %.2f, p99 %.2f, max %.2f ms",
+                    label,
+                    summary.p50,
+                    summary.p95,
+                    summary.p99,
+                    summary.max);
+        std::snprintf(overlay,
+                      sizeof(overlay),
+                      "%.2f ms",
+                      values.empty() ? 0.0f : values.back());
+        ImGui::PlotLines("##values",
+                         values.data(),
+                         static_cast<int>(values.size()),
+                         0,
+                         overlay,
+                         0.0f,
+                         FLT_MAX,
+                         ImVec2(0, 40));
+        std::snprintf(overlay, sizeof(overlay), "0 - %.2f ms", summary.max);
+        ImGui::PlotHistogram("##histogram",
+                             bins.data(),
+                             static_cast<int>(bins.size()),
+                             0,
+                             overlay,
+                             0.0f,
+                             FLT_MAX,
+                             ImVec2(0, 40));
+        ImGui::PopID();
+      };
+      timing("Frame", frame_times);
+      timing("Step", simulation.step_times);
+      timing("Render", render_times);
+    }
+
+    if (ImGui::CollapsingHeader("Memory")) {
+      const auto stats = simulation.simulator->getMemoryStats();
+      for (const auto& [label, bytes] : memory_parts(stats)) {
+        ImGui::Text("%-20s %10.3f MiB", label, bytes / (1024.0 * 1024.0));
+      }
+      ImGui::Text("%-20s %10.3f MiB",
+                  "Total",
+                  stats.getTotal() / (1024.0 * 1024.0));
+    }
+
+    /* What the solver did in the last step, to explain slow scenes. */
+    if (ImGui::CollapsingHeader("Solver")) {
+      const auto stats = simulation.simulator->getSolverStats();
+      const double agents = std::max<double>(stats.agents, 1);
+      ImGui::Text("Agents: %llu, colliding: %llu\n"
+                  "Obstacle lines: %llu (%.2f per agent)\n"
+                  "Agent lines: %llu (%.2f per agent)\n"
+                  "Covered obstacles: %llu\n"
+                  "1D linear programs: %.2f per agent\n"
+                  "3D fallbacks: %llu (%.1f%%)",
+                  stats.agents,
+                  stats.collidingAgents,
+                  stats.obstacleLines,
+                  stats.obstacleLines / agents,
+                  stats.agentLines,
+                  stats.agentLines / agents,
+                  stats.coveredObstacles,
+                  stats.linearProgram1Calls / agents,
+                  stats.linearProgram3Calls,
+                  100.0 * stats.linearProgram3Calls / agents);
+    }
+
+    std::vector<size_t> nearby_agents;
+    if (simulation.selected_agent < simulation.simulator->getNumAgents()) {
+      const auto agent = simulation.selected_agent;
+      const auto& position = simulation.simulator->getAgentPosition(agent);
+      const auto& velocity = simulation.simulator->getAgentVelocity(agent);
+      simulation.simulator->queryAgentsInRadius(
+        position, simulation.simulator->getAgentNeighborDist(agent),
+        nearby_agents);
+      ImGui::Text("Selected agent: %zu\n"
+                  "\tPosition: (%.2f, %.2f)\n"
+                  "\tVelocity: (%.2f, %.2f)\n"
+                  "\tAgents within neighbor distance: %zu",
+                  agent,
+                  position.x(),
+                  position.y(),
+                  velocity.x(),
+                  velocity.y(),
+                  nearby_agents.size() - 1);
+    }
+
     if (!simulation.staging_obstacle.empty()) {
       if (ImGui::Button("Add Obstacle")) {
-        simulation.commit_obstacle();
+        simulation.commit_obstacle(simulation_options);
       }
     }
 
     if (ImGui::Button("Reset")) {
       simulation.initialize(simulation_options);
     }
+
+    ImGui::InputText(
+      "Scenario File", options.scenario_path, sizeof(options.scenario_path));
+    if (ImGui::Button("Load Scenario") &&
+        simulation.load_scenario(options.scenario_path)) {
+      simulation_options.configuration = Simulation::SCENARIO;
+      simulation.initialize(simulation_options);
+    }
+    if (simulation.scenario.is_open()) {
+      ImGui::SameLine();
+      ImGui::Text("%zu agents, %zu obstacles",
+                  simulation.scenario.agents_size(),
+                  simulation.scenario.obstacles_size());
+    }
+
+    if (simulation.recorder.is_open()) {
+      if (ImGui::Button("Stop Recording")) {
+        simulation.stop_recording();
+      } else {
+        ImGui::SameLine();
+        ImGui::Text("%llu frames, %llu dropped, %.1f MiB",
+                    static_cast<unsigned long long>(simulation.recorder.frames()),
+                    static_cast<unsigned long long>(
+                      simulation.recorder.dropped_frames()),
+                    simulation.recorder.bytes_written() / (1024.0 * 1024.0));
+      }
+    } else {
+      ImGui::InputText(
+        "Trajectory File", options.trajectory_path, sizeof(options.trajectory_path));
+      if (ImGui::Button("Start Recording")) {
+        simulation.start_recording(options.trajectory_path, simulation_options);
+      }
+    }
+
+    if (replay.is_open()) {
+      const uint64_t first_frame = 0;
+      const uint64_t last_frame = replay.reader.frames() - 1;
+      uint64_t frame = replay.frame;
+      if (ImGui::SliderScalar("Frame",
+                              ImGuiDataType_U64,
+                              &frame,
+                              &first_frame,
+                              &last_frame)) {
+        replay.seek(frame);
+      }
+      ImGui::Checkbox("Play Replay", &replay.playing);
+      ImGui::SameLine();
+      ImGui::Text("t = %.2f s", replay.time);
+      if (ImGui::Button("Close Replay")) {
+        replay.close();
+      }
+    } else {
+      ImGui::InputText(
+        "Replay File", options.replay_path, sizeof(options.replay_path));
+      if (ImGui::Button("Open Replay")) {
+        replay.open(options.replay_path);
+      }
+    }
+
+#if RVO_TRACING
+    ImGui::InputText(
+      "Trace File", options.trace_path, sizeof(options.trace_path));
+    if (ImGui::Button("Write Trace")) {
+      RVO::Trace::write(options.trace_path);
+    }
+#endif
     ImGui::End();
+    RVO_TRACE_END(build_ui_scope);
+
+    RVO_TRACE_BEGIN(draw_scene_scope, "draw_scene");
 
     const SDL_Rect clip = {
       0, 0, static_cast<int>(width), static_cast<int>(height)
@@ -327,7 +1320,14 @@ public:
                            SDL_ALPHA_OPAQUE);
     SDL_RenderClear(renderer);
 
-    if (simulation_options.show_goal) {
+    const Trajectory::agent_state_t* replay_states = nullptr;
+    uint32_t replay_agents = 0;
+    if (replay.is_open()) {
+      replay_states = replay.reader.states(replay.frame);
+      replay_agents = replay.reader.header(replay.frame).num_agents;
+    }
+
+    if (simulation_options.show_goal && !replay_states) {
       SDL_SetRenderDrawColor(renderer,
                              options.goal_color[0],
                              options.goal_color[1],
@@ -335,12 +1335,27 @@ public:
                              SDL_ALPHA_OPAQUE);
       for (uint32_t i = 0; i < simulation.simulator->getNumAgents(); ++i) {
         auto point = toScreenSpace(simulation.simulator->getAgentPosition(i));
-        auto goal = toScreenSpace(simulation.goals[i]);
+        auto goal = toScreenSpace(simulation.waypoint(i));
         SDL_RenderDrawLine(renderer, point.x(), point.y(), goal.x(), goal.y());
       }
     }
 
-    if (simulation_options.show_velocity) {
+    if (simulation_options.show_velocity && replay_states) {
+      SDL_SetRenderDrawColor(renderer,
+                             options.velocity_color[0],
+                             options.velocity_color[1],
+                             options.velocity_color[2],
+                             SDL_ALPHA_OPAQUE);
+      for (uint32_t i = 0; i < replay_agents; ++i) {
+        const auto& state = replay_states[i];
+        auto point =
+          toScreenSpace(RVO::Vector2(state.position[0], state.position[1]));
+        auto goal = toScreenSpace(
+          RVO::Vector2(state.position[0] + state.velocity[0],
+                       state.position[1] + state.velocity[1]));
+        SDL_RenderDrawLine(renderer, point.x(), point.y(), goal.x(), goal.y());
+      }
+    } else if (simulation_options.show_velocity) {
       SDL_SetRenderDrawColor(renderer,
                              options.velocity_color[0],
                              options.velocity_color[1],
@@ -361,17 +1376,14 @@ public:
       }
     }
 
-    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, SDL_ALPHA_OPAQUE);
-    for (uint32_t i = 0; i < simulation.simulator->getNumAgents(); ++i) {
-      auto point = toScreenSpace(simulation.simulator->getAgentPosition(i));
-      int w = static_cast<int>(simulation_options.radius * 2 * options.scale);
-      int h = static_cast<int>(simulation_options.radius * 2 * options.scale);
+    auto draw_agent_at = [&](const RVO::Vector2& position, float radius) {
+      auto point = toScreenSpace(position);
+      int w = static_cast<int>(radius * 2 * options.scale);
+      int h = static_cast<int>(radius * 2 * options.scale);
       if (w > 1 && h > 1) {
         SDL_Rect rect{
-          static_cast<int>(point.x() -
-                           simulation_options.radius * options.scale),
-          static_cast<int>(point.y() -
-                           simulation_options.radius * options.scale),
+          static_cast<int>(point.x() - radius * options.scale),
+          static_cast<int>(point.y() - radius * options.scale),
           w,
           h,
         };
@@ -379,6 +1391,40 @@ public:
       } else {
         SDL_RenderDrawPoint(renderer, point.x(), point.y());
       }
+    };
+    auto draw_agent = [&](size_t i) {
+      draw_agent_at(simulation.simulator->getAgentPosition(i),
+                    simulation_options.radius);
+    };
+
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, SDL_ALPHA_OPAQUE);
+    if (replay_states) {
+      for (uint32_t i = 0; i < replay_agents; ++i) {
+        draw_agent_at(RVO::Vector2(replay_states[i].position[0],
+                                   replay_states[i].position[1]),
+                      replay.radius);
+      }
+    } else {
+      for (uint32_t i = 0; i < simulation.simulator->getNumAgents(); ++i) {
+        draw_agent(i);
+      }
+    }
+
+    if (!nearby_agents.empty() && !replay_states) {
+      SDL_SetRenderDrawColor(renderer,
+                             options.nearby_color[0],
+                             options.nearby_color[1],
+                             options.nearby_color[2],
+                             SDL_ALPHA_OPAQUE);
+      for (auto i : nearby_agents) {
+        draw_agent(i);
+      }
+      SDL_SetRenderDrawColor(renderer,
+                             options.selection_color[0],
+                             options.selection_color[1],
+                             options.selection_color[2],
+                             SDL_ALPHA_OPAQUE);
+      draw_agent(simulation.selected_agent);
     }
 
     // Obstacles
@@ -396,6 +1442,24 @@ public:
         previous = point;
       }
     }
+    for (size_t i = 0; i < simulation.scenario_obstacles(simulation_options);
+         ++i) {
+      const auto& scenario = simulation.scenario;
+      const size_t begin = scenario.obstacle_begin(i);
+      const size_t end = scenario.obstacle_end(i);
+      if (end - begin < 3) {
+        continue;
+      }
+      auto vertex = scenario.vertex(end - 1).position;
+      previous = toScreenSpace(RVO::Vector2(vertex[0], vertex[1]));
+      for (size_t j = begin; j < end; ++j) {
+        vertex = scenario.vertex(j).position;
+        auto point = toScreenSpace(RVO::Vector2(vertex[0], vertex[1]));
+        SDL_RenderDrawLine(
+          renderer, previous.x(), previous.y(), point.x(), point.y());
+        previous = point;
+      }
+    }
 
     // Staging obstacle
     SDL_SetRenderDrawColor(renderer, 0x7F, 0x7F, 0x7F, SDL_ALPHA_OPAQUE);
@@ -430,9 +1494,18 @@ public:
       }
     }
 
+    RVO_TRACE_END(draw_scene_scope);
+
+    RVO_TRACE_BEGIN(render_ui_scope, "render_ui");
     ImGui::Render();
     ImGuiSDL::Render(ImGui::GetDrawData());
+    RVO_TRACE_END(render_ui_scope);
 
+    render_times.add(std::chrono::duration<float, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count());
+
+    RVO_TRACE_SCOPE("present");
     SDL_RenderPresent(renderer);
   }
 
@@ -460,6 +1533,8 @@ public:
   options_t options;
   uint32_t width;
   uint32_t height;
+  TimingHistory frame_times;
+  TimingHistory render_times;
 };
 
 #if __EMSCRIPTEN__
@@ -470,8 +1545,9 @@ em_main_loop_callback(void* arg);
 class App
 {
 public:
-  App()
+  explicit App(const Simulation::options_t& options = {})
     : time_stamp(std::chrono::high_resolution_clock::now())
+    , simulation_options(options)
   {
     simulation.initialize(simulation_options);
   }
@@ -479,18 +1555,23 @@ public:
 
   bool main_loop()
   {
+    RVO_TRACE_SCOPE("main_loop");
     auto now = std::chrono::high_resolution_clock::now();
     auto dt = std::chrono::duration_cast<std::chrono::duration<float>>(
       now - time_stamp);
     time_stamp = now;
 
-    renderer.draw(dt.count(), simulation, simulation_options);
+    renderer.draw(dt.count(), simulation, simulation_options, replay);
 
-    if (simulation_options.run_simulation) {
+    if (replay.is_open()) {
+      replay.advance(simulation_options.time_scale * dt.count());
+    } else if (simulation_options.run_simulation) {
       simulation.set_preferred_velocities();
-      simulation.step(simulation_options.time_scale * dt.count());
+      simulation.step(simulation_options.time_scale * dt.count(),
+                      simulation_options);
     }
 
+    RVO_TRACE_SCOPE("poll_events");
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
       ImGui_ImplSDL2_ProcessEvent(&event);
@@ -504,10 +1585,16 @@ public:
             event.button.clicks == 2) {
           simulation.staging_obstacle.emplace_back(renderer.fromScreenSpace(
             RVO::Vector2(event.button.x, event.button.y)));
+        } else if (event.button.button == SDL_BUTTON_LEFT &&
+                   event.button.clicks == 1) {
+          simulation.select_agent(renderer.fromScreenSpace(RVO::Vector2(
+                                    event.button.x, event.button.y)),
+                                  std::max(simulation_options.radius,
+                                           4.0f / renderer.options.scale));
         } else if (event.button.button == SDL_BUTTON_RIGHT) {
           simulation.staging_obstacle.emplace_back(renderer.fromScreenSpace(
             RVO::Vector2(event.button.x, event.button.y)));
-          simulation.commit_obstacle();
+          simulation.commit_obstacle(simulation_options);
         }
       } else if (event.type == SDL_MOUSEWHEEL &&
                  !renderer.ui_want_capture_mouse()) {
@@ -559,7 +1646,128 @@ public:
     return EXIT_SUCCESS;
   }
 
-  void terminate() { renderer.terminate(); }
+  /* Run a fixed number of steps without opening a window. */
+  int run_headless(uint64_t steps, float time_step)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < steps; ++i) {
+      simulation.set_preferred_velocities();
+      simulation.step(time_step, simulation_options);
+    }
+    auto simulated = std::chrono::steady_clock::now();
+    simulation.stop_recording();
+    auto end = std::chrono::steady_clock::now();
+
+    std::printf(
+      "Simulated %llu steps of %zu agents in %.3f seconds (%.3f flushing)\n",
+      static_cast<unsigned long long>(steps),
+      simulation.simulator->getNumAgents(),
+      std::chrono::duration<double>(end - start).count(),
+      std::chrono::duration<double>(end - simulated).count());
+    std::vector<float> step_times;
+    simulation.step_times.window(
+      std::chrono::duration<float>(end - start).count() + 1.0f, step_times);
+    const auto summary = TimingHistory::summarize(step_times);
+    std::printf("Step time of the last %zu steps: p50 %.3f, p95 %.3f, "
+                "p99 %.3f, max %.3f ms\n",
+                summary.count,
+                summary.p50,
+                summary.p95,
+                summary.p99,
+                summary.max);
+    const auto& stats = simulation.solver_totals;
+    const double agents = std::max<double>(stats.agents, 1);
+    std::printf("Per agent and step: %.2f obstacle lines, %.2f agent lines, "
+                "%.2f 1D linear programs, %.3f%% 3D fallbacks, "
+                "%.3f%% colliding\n",
+                stats.obstacleLines / agents,
+                stats.agentLines / agents,
+                stats.linearProgram1Calls / agents,
+                100.0 * stats.linearProgram3Calls / agents,
+                100.0 * stats.collidingAgents / agents);
+    if (RVO::PerfCounters::isEnabled()) {
+      print_perf_counters(stats.agents);
+    }
+    const auto memory = simulation.simulator->getMemoryStats();
+    std::printf("Memory: %.3f MiB\n", memory.getTotal() / (1024.0 * 1024.0));
+    for (const auto& [label, bytes] : memory_parts(memory)) {
+      std::printf("  %-20s %10.3f MiB\n", label, bytes / (1024.0 * 1024.0));
+    }
+    if (simulation_options.configuration == Simulation::STREAM) {
+      std::printf("Despawned %llu agents\n",
+                  static_cast<unsigned long long>(simulation.despawned_agents));
+    }
+    return EXIT_SUCCESS;
+  }
+
+  /* Cycles, IPC and misses per agent and step of each step phase. */
+  static void print_perf_counters(unsigned long long agent_steps)
+  {
+    using RVO::PerfCounters;
+    const double agents = std::max<double>(agent_steps, 1);
+    std::printf("%-20s %14s %6s %14s %14s\n",
+                "Phase",
+                "cycles/agent",
+                "IPC",
+                "cache miss/ag",
+                "branch miss/ag");
+    auto column = [&](PerfCounters::Phase phase,
+                      PerfCounters::Counter counter,
+                      int width,
+                      int precision) {
+      if (PerfCounters::isAvailable(counter)) {
+        std::printf(" %*.*f",
+                    width,
+                    precision,
+                    PerfCounters::getTotal(phase, counter) / agents);
+      } else {
+        std::printf(" %*s", width, "n/a");
+      }
+    };
+    for (int i = 0; i < PerfCounters::NUM_PHASES; ++i) {
+      const auto phase = static_cast<PerfCounters::Phase>(i);
+      std::printf("%-20s", PerfCounters::getName(phase));
+      column(phase, PerfCounters::CYCLES, 14, 1);
+      const auto cycles = PerfCounters::getTotal(phase, PerfCounters::CYCLES);
+      if (PerfCounters::isAvailable(PerfCounters::CYCLES) &&
+          PerfCounters::isAvailable(PerfCounters::INSTRUCTIONS) &&
+          cycles > 0) {
+        std::printf(
+          " %6.2f",
+          static_cast<double>(
+            PerfCounters::getTotal(phase, PerfCounters::INSTRUCTIONS)) /
+            cycles);
+      } else {
+        std::printf(" %6s", "n/a");
+      }
+      column(phase, PerfCounters::CACHE_MISSES, 14, 3);
+      column(phase, PerfCounters::BRANCH_MISSES, 14, 3);
+      std::printf("\n");
+    }
+  }
+
+  bool start_recording(const char* path)
+  {
+    return simulation.start_recording(path, simulation_options);
+  }
+
+  bool open_replay(const char* path) { return replay.open(path); }
+
+  bool load_scenario(const char* path)
+  {
+    if (!simulation.load_scenario(path)) {
+      return false;
+    }
+    simulation_options.configuration = Simulation::SCENARIO;
+    simulation.initialize(simulation_options);
+    return true;
+  }
+
+  void terminate()
+  {
+    simulation.stop_recording();
+    renderer.terminate();
+  }
 
 private:
   std::chrono::time_point<
@@ -573,6 +1781,7 @@ private:
   Renderer renderer;
   Simulation::options_t simulation_options;
   Simulation simulation;
+  Replay replay;
 };
 
 #if __EMSCRIPTEN__
@@ -587,9 +1796,148 @@ em_main_loop_callback(void* arg)
 }
 #endif
 
+void
+print_usage(const char* program)
+{
+  std::printf("Usage: %s [options]\n"
+              "  --headless             Run without a window\n"
+              "  --steps N              Steps to simulate headless (1000)\n"
+              "  --time-step S          Seconds per headless step (0.25)\n"
+              "  --record FILE          Record the trajectory to FILE\n"
+              "  --replay FILE          Open a recorded trajectory\n"
+              "  --agents N             Number of agents in the circle\n"
+              "  --configuration NAME   Circle, Deadlock, Stream or Scenario\n"
+              "  --scenario FILE        Load a text or binary scenario file\n"
+              "  --convert-scenario OUT Write the scenario as binary and exit\n"
+              "  --work-stealing        Use the work-stealing thread pool\n"
+              "  --warm-start-lp        Test last step's tight constraints first\n"
+              "  --random-lp-order      Test agent constraints in random order\n"
+              "  --threads N            Threads of the pool (all cores)\n"
+              "  --trace FILE           Write a Chrome trace on exit\n"
+              "                         (builds with RVO_TRACING)\n"
+              "  --perf-counters        Report hardware counters per step\n"
+              "                         phase of headless runs (Linux)\n"
+              "  --capture-lp FILE      Write the linear programs of every\n"
+              "                         16th agent in every 4th step to FILE\n",
+              program);
+}
+
 int
 main(int argc, char* argv[])
 {
-  App app;
-  return app.run();
+  Simulation::options_t options;
+  bool headless = false;
+  uint64_t steps = 1000;
+  float time_step = 0.25f;
+  const char* record_path = nullptr;
+  const char* replay_path = nullptr;
+  const char* scenario_path = nullptr;
+  const char* convert_path = nullptr;
+  const char* trace_path = nullptr;
+  bool perf_counters = false;
+  const char* capture_path = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--headless") {
+      headless = true;
+    } else if (arg == "--steps" && has_value) {
+      steps = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--time-step" && has_value) {
+      time_step = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--record" && has_value) {
+      record_path = argv[++i];
+    } else if (arg == "--replay" && has_value) {
+      replay_path = argv[++i];
+    } else if (arg == "--scenario" && has_value) {
+      scenario_path = argv[++i];
+    } else if (arg == "--convert-scenario" && has_value) {
+      convert_path = argv[++i];
+    } else if (arg == "--perf-counters") {
+      perf_counters = true;
+    } else if (arg == "--capture-lp" && has_value) {
+      capture_path = argv[++i];
+    } else if (arg == "--trace" && has_value) {
+      trace_path = argv[++i];
+    } else if (arg == "--agents" && has_value) {
+      options.numAgents = std::max(std::atoi(argv[++i]), 0);
+    } else if (arg == "--work-stealing") {
+      options.work_stealing = true;
+    } else if (arg == "--warm-start-lp") {
+      options.warm_start_lp = true;
+    } else if (arg == "--random-lp-order") {
+      options.random_lp_order = true;
+    } else if (arg == "--threads" && has_value) {
+      options.numThreads = std::atoi(argv[++i]);
+    } else if (arg == "--configuration" && has_value) {
+      std::string_view name = argv[++i];
+      auto it = std::find_if(
+        Simulation::configuration_strings.begin(),
+        Simulation::configuration_strings.end(),
+        [name](std::string_view s) {
+          return s.size() == name.size() &&
+                 std::equal(s.begin(), s.end(), name.begin(), [](char a, char b) {
+                   return std::tolower(a) == std::tolower(b);
+                 });
+        });
+      if (it == Simulation::configuration_strings.end()) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      options.configuration = static_cast<Simulation::configuration_t>(
+        it - Simulation::configuration_strings.begin());
+    } else {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (convert_path) {
+    if (!scenario_path) {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    ScenarioReader scenario;
+    return scenario.open(scenario_path) && scenario.write_binary(convert_path)
+             ? EXIT_SUCCESS
+             : EXIT_FAILURE;
+  }
+
+#if RVO_TRACING
+  RVO::Trace::setThreadName("main");
+#endif
+  App app(options);
+  if (scenario_path && !app.load_scenario(scenario_path)) {
+    return EXIT_FAILURE;
+  }
+  if (record_path && !app.start_recording(record_path)) {
+    return EXIT_FAILURE;
+  }
+  if (!headless && replay_path && !app.open_replay(replay_path)) {
+    return EXIT_FAILURE;
+  }
+  if (perf_counters && !RVO::PerfCounters::enable()) {
+    std::printf("Hardware counters are unavailable, check that the processor "
+                "exposes them and /proc/sys/kernel/perf_event_paranoid\n");
+  }
+  if (capture_path) {
+    RVO::ConstraintCapture::enable(16, 4, 200000);
+  }
+  int result = headless ? app.run_headless(steps, time_step) : app.run();
+  if (capture_path) {
+    RVO::ConstraintCapture::disable();
+    if (RVO::ConstraintCapture::write(capture_path)) {
+      std::printf("Captured %zu linear programs to %s\n",
+                  RVO::ConstraintCapture::getNumRecords(), capture_path);
+    } else {
+      std::printf("Failed to write linear program corpus %s\n", capture_path);
+      result = EXIT_FAILURE;
+    }
+  }
+  if (trace_path && !RVO::Trace::write(trace_path)) {
+    std::printf("Failed to write trace file %s\n", trace_path);
+    result = EXIT_FAILURE;
+  }
+  return result;
 }
@@ -0,0 +1,479 @@
+#pragma once
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SCENARIO_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Scenario files.
+ *
+ * The text format is a sequence of whitespace separated statements; '#'
+ * starts a comment that runs to the end of the line.
+ *
+ *   profile NEIGHBOR_DIST MAX_NEIGHBORS TAU TAU_OBSTACLES RADIUS MAX_SPEED
+ *   profile default
+ *   agent X Y GOAL_X GOAL_Y
+ *   obstacle N X1 Y1 ... XN YN
+ *
+ * An agent uses the profile declared last before it, or the application's
+ * agent defaults before the first profile and after "profile default".
+ * Obstacle vertices are listed counterclockwise, or clockwise for a bounding
+ * polygon, as for RVO::RVOSimulator::addObstacle. Statements may span lines.
+ *
+ * The binary format holds the same data in arrays that are used in place
+ * when the file is mapped: a header, the profiles, the agents, the end of
+ * every obstacle in the vertex array and the vertices. All records are 8
+ * byte aligned.
+ */
+struct Scenario
+{
+  static constexpr std::array<char, 4> file_magic{ 'R', 'V', 'O', 'S' };
+  static constexpr uint32_t format_version{ 1 };
+  static constexpr uint32_t default_profile{
+    std::numeric_limits<uint32_t>::max()
+  };
+
+  struct file_header_t
+  {
+    char magic[4];
+    uint32_t version;
+    uint64_t num_profiles;
+    uint64_t num_agents;
+    uint64_t num_obstacles;
+    uint64_t num_vertices;
+  };
+
+  struct profile_t
+  {
+    float neighbor_dist;
+    uint32_t max_neighbors;
+    float time_horizon;
+    float time_horizon_obst;
+    float radius;
+    float max_speed;
+  };
+
+  struct agent_t
+  {
+    float position[2];
+    float goal[2];
+    /* Index into the profiles, or default_profile. */
+    uint32_t profile;
+    uint32_t reserved;
+  };
+
+  struct vertex_t
+  {
+    float position[2];
+  };
+};
+
+static_assert(sizeof(Scenario::file_header_t) == 40);
+static_assert(sizeof(Scenario::profile_t) == 24);
+static_assert(sizeof(Scenario::agent_t) == 24);
+static_assert(sizeof(Scenario::vertex_t) == 8);
+
+/*
+ * Loads a scenario from a text or binary file. Binary files are mapped and
+ * read in place where possible; text files are parsed in fixed size chunks so
+ * that large maps never need to be held as text in memory.
+ */
+class ScenarioReader
+{
+public:
+  ScenarioReader() = default;
+  ScenarioReader(const ScenarioReader&) = delete;
+  ScenarioReader& operator=(const ScenarioReader&) = delete;
+  ~ScenarioReader() { close(); }
+
+  bool open(const char* path)
+  {
+    close();
+
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file) {
+      std::printf("Failed to open scenario file %s\n", path);
+      return false;
+    }
+    char magic[4] = {};
+    bool binary = std::fread(magic, 1, 4, file) == 4 &&
+                  std::memcmp(magic, Scenario::file_magic.data(), 4) == 0;
+    std::fseek(file, 0, SEEK_SET);
+
+    bool valid = binary ? open_binary(path, file) : parse(file);
+    std::fclose(file);
+    if (!valid) {
+      std::printf("Invalid scenario file %s", path);
+      if (!binary) {
+        std::printf(" at line %zu", line);
+      }
+      std::printf("\n");
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close()
+  {
+#if SCENARIO_MMAP
+    if (mapped) {
+      munmap(const_cast<char*>(mapping), mapping_size);
+    }
+#endif
+    mapping = nullptr;
+    mapping_size = 0;
+    mapped = false;
+    buffer.clear();
+    buffer.shrink_to_fit();
+    owned_profiles.clear();
+    owned_agents.clear();
+    owned_ends.clear();
+    owned_vertices.clear();
+    profiles = nullptr;
+    agents = nullptr;
+    obstacle_ends = nullptr;
+    vertices = nullptr;
+    num_profiles = num_agents = num_obstacles = num_vertices = 0;
+    is_loaded = false;
+  }
+
+  bool is_open() const { return is_loaded; }
+
+  size_t profiles_size() const { return num_profiles; }
+  size_t agents_size() const { return num_agents; }
+  size_t obstacles_size() const { return num_obstacles; }
+  size_t vertices_size() const { return num_vertices; }
+
+  const Scenario::profile_t& profile(size_t i) const { return profiles[i]; }
+  const Scenario::agent_t& agent(size_t i) const { return agents[i]; }
+  const Scenario::vertex_t& vertex(size_t i) const { return vertices[i]; }
+
+  /* Vertices of an obstacle, from obstacle_begin(i) to obstacle_end(i). */
+  size_t obstacle_begin(size_t i) const
+  {
+    return i == 0 ? 0 : obstacle_ends[i - 1];
+  }
+  size_t obstacle_end(size_t i) const { return obstacle_ends[i]; }
+
+  /* Write the loaded scenario in the binary format. */
+  bool write_binary(const char* path) const
+  {
+    std::FILE* file = std::fopen(path, "wb");
+    if (!file) {
+      std::printf("Failed to open scenario file %s\n", path);
+      return false;
+    }
+    Scenario::file_header_t header{};
+    std::memcpy(header.magic, Scenario::file_magic.data(), 4);
+    header.version = Scenario::format_version;
+    header.num_profiles = num_profiles;
+    header.num_agents = num_agents;
+    header.num_obstacles = num_obstacles;
+    header.num_vertices = num_vertices;
+    bool good =
+      std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+      std::fwrite(profiles, sizeof(*profiles), num_profiles, file) ==
+        num_profiles &&
+      std::fwrite(agents, sizeof(*agents), num_agents, file) == num_agents &&
+      std::fwrite(obstacle_ends, sizeof(*obstacle_ends), num_obstacles, file) ==
+        num_obstacles &&
+      std::fwrite(vertices, sizeof(*vertices), num_vertices, file) ==
+        num_vertices;
+    good = std::fclose(file) == 0 && good;
+    if (!good) {
+      std::printf("Failed to write scenario file %s\n", path);
+    }
+    return good;
+  }
+
+private:
+  bool open_binary(const char* path, std::FILE* file)
+  {
+#if SCENARIO_MMAP
+    int fd = ::open(path, O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        mapping = static_cast<const char*>(data);
+        mapping_size = st.st_size;
+        mapped = true;
+      }
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+#endif
+
+    if (!mapping) {
+      std::fseek(file, 0, SEEK_END);
+      long length = std::ftell(file);
+      std::fseek(file, 0, SEEK_SET);
+      if (length <= 0) {
+        return false;
+      }
+      /* Stored as 8 byte words to keep the records aligned. */
+      buffer.resize((length + 7) / 8);
+      if (std::fread(buffer.data(), 1, length, file) !=
+          static_cast<size_t>(length)) {
+        return false;
+      }
+      mapping = reinterpret_cast<const char*>(buffer.data());
+      mapping_size = length;
+    }
+
+    if (mapping_size < sizeof(Scenario::file_header_t)) {
+      return false;
+    }
+    const auto* header =
+      reinterpret_cast<const Scenario::file_header_t*>(mapping);
+    if (header->version != Scenario::format_version) {
+      return false;
+    }
+    /* Bound every count by the file size before multiplying. */
+    const uint64_t limit = mapping_size / sizeof(Scenario::vertex_t);
+    if (header->num_profiles > limit || header->num_agents > limit ||
+        header->num_obstacles > limit || header->num_vertices > limit) {
+      return false;
+    }
+    const uint64_t expected =
+      sizeof(*header) + header->num_profiles * sizeof(Scenario::profile_t) +
+      header->num_agents * sizeof(Scenario::agent_t) +
+      header->num_obstacles * sizeof(uint64_t) +
+      header->num_vertices * sizeof(Scenario::vertex_t);
+    if (expected != mapping_size) {
+      return false;
+    }
+
+    const char* cursor = mapping + sizeof(*header);
+    profiles = reinterpret_cast<const Scenario::profile_t*>(cursor);
+    cursor += header->num_profiles * sizeof(Scenario::profile_t);
+    agents = reinterpret_cast<const Scenario::agent_t*>(cursor);
+    cursor += header->num_agents * sizeof(Scenario::agent_t);
+    obstacle_ends = reinterpret_cast<const uint64_t*>(cursor);
+    cursor += header->num_obstacles * sizeof(uint64_t);
+    vertices = reinterpret_cast<const Scenario::vertex_t*>(cursor);
+    num_profiles = header->num_profiles;
+    num_agents = header->num_agents;
+    num_obstacles = header->num_obstacles;
+    num_vertices = header->num_vertices;
+
+    for (size_t i = 0; i < num_agents; ++i) {
+      if (agents[i].profile != Scenario::default_profile &&
+          agents[i].profile >= num_profiles) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < num_obstacles; ++i) {
+      if (obstacle_ends[i] < obstacle_begin(i) + 2 ||
+          obstacle_ends[i] > num_vertices) {
+        return false;
+      }
+    }
+    is_loaded = true;
+    return true;
+  }
+
+  bool parse(std::FILE* file)
+  {
+    source = file;
+    text.resize(chunk_size);
+    text_begin = text_end = 0;
+    line = 1;
+    eof = false;
+    in_comment = false;
+
+    uint32_t current_profile = Scenario::default_profile;
+    std::string_view token;
+    while (next(token)) {
+      if (token == "profile") {
+        if (!next(token)) {
+          return false;
+        }
+        if (token == "default") {
+          current_profile = Scenario::default_profile;
+          continue;
+        }
+        Scenario::profile_t profile;
+        if (!to_float(token, profile.neighbor_dist) ||
+            !read(profile.max_neighbors) || !read(profile.time_horizon) ||
+            !read(profile.time_horizon_obst) || !read(profile.radius) ||
+            !read(profile.max_speed)) {
+          return false;
+        }
+        current_profile = static_cast<uint32_t>(owned_profiles.size());
+        owned_profiles.push_back(profile);
+      } else if (token == "agent") {
+        Scenario::agent_t agent{};
+        if (!read(agent.position[0]) || !read(agent.position[1]) ||
+            !read(agent.goal[0]) || !read(agent.goal[1])) {
+          return false;
+        }
+        agent.profile = current_profile;
+        owned_agents.push_back(agent);
+      } else if (token == "obstacle") {
+        uint32_t count = 0;
+        if (!read(count) || count < 2) {
+          return false;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+          Scenario::vertex_t vertex;
+          if (!read(vertex.position[0]) || !read(vertex.position[1])) {
+            return false;
+          }
+          owned_vertices.push_back(vertex);
+        }
+        owned_ends.push_back(owned_vertices.size());
+      } else {
+        return false;
+      }
+    }
+    text.clear();
+    text.shrink_to_fit();
+    profiles = owned_profiles.data();
+    agents = owned_agents.data();
+    obstacle_ends = owned_ends.data();
+    vertices = owned_vertices.data();
+    num_profiles = owned_profiles.size();
+    num_agents = owned_agents.size();
+    num_obstacles = owned_ends.size();
+    num_vertices = owned_vertices.size();
+    is_loaded = true;
+    return true;
+  }
+
+  /* Refill the chunk, keeping the unread bytes. Returns false at the end. */
+  bool refill()
+  {
+    if (eof) {
+      return false;
+    }
+    std::memmove(text.data(), text.data() + text_begin, text_end - text_begin);
+    text_end -= text_begin;
+    text_begin = 0;
+    if (text_end == text.size()) {
+      /* A single token fills the chunk. */
+      text.resize(text.size() * 2);
+    }
+    size_t count =
+      std::fread(text.data() + text_end, 1, text.size() - text_end, source);
+    text_end += count;
+    eof = count == 0;
+    return !eof;
+  }
+
+  /* Read the next token. Returns false at the end of the file. */
+  bool next(std::string_view& token)
+  {
+    for (;;) {
+      while (text_begin < text_end) {
+        char c = text[text_begin];
+        if (in_comment || c == '#') {
+          /* Skip the comment up to the end of the line, across chunks. */
+          while (text_begin < text_end && text[text_begin] != '\n') {
+            ++text_begin;
+          }
+          in_comment = text_begin == text_end;
+        } else if (c == '\n') {
+          ++line;
+          ++text_begin;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+          ++text_begin;
+        } else {
+          size_t end = text_begin;
+          while (end < text_end && text[end] != '#' &&
+                 !std::isspace(static_cast<unsigned char>(text[end]))) {
+            ++end;
+          }
+          if (end == text_end && !eof) {
+            /* The token may continue in the next chunk. */
+            refill();
+            continue;
+          }
+          token = std::string_view(text.data() + text_begin, end - text_begin);
+          text_begin = end;
+          return true;
+        }
+      }
+      if (!refill()) {
+        return false;
+      }
+    }
+  }
+
+  static bool to_float(std::string_view token, float& value)
+  {
+    char number[64];
+    if (token.size() >= sizeof(number)) {
+      return false;
+    }
+    std::memcpy(number, token.data(), token.size());
+    number[token.size()] = '\0';
+    char* end = nullptr;
+    value = std::strtof(number, &end);
+    return end == number + token.size();
+  }
+
+  bool read(float& value)
+  {
+    std::string_view token;
+    return next(token) && to_float(token, value);
+  }
+
+  bool read(uint32_t& value)
+  {
+    float number;
+    if (!read(number) || number < 0 ||
+        number > std::numeric_limits<uint32_t>::max() ||
+        number != static_cast<uint32_t>(number)) {
+      return false;
+    }
+    value = static_cast<uint32_t>(number);
+    return true;
+  }
+
+  static constexpr size_t chunk_size = 1 << 20;
+
+  const char* mapping{ nullptr };
+  size_t mapping_size{ 0 };
+  bool mapped{ false };
+  std::vector<uint64_t> buffer;
+
+  std::vector<Scenario::profile_t> owned_profiles;
+  std::vector<Scenario::agent_t> owned_agents;
+  std::vector<uint64_t> owned_ends;
+  std::vector<Scenario::vertex_t> owned_vertices;
+
+  const Scenario::profile_t* profiles{ nullptr };
+  const Scenario::agent_t* agents{ nullptr };
+  const uint64_t* obstacle_ends{ nullptr };
+  const Scenario::vertex_t* vertices{ nullptr };
+  size_t num_profiles{ 0 };
+  size_t num_agents{ 0 };
+  size_t num_obstacles{ 0 };
+  size_t num_vertices{ 0 };
+  bool is_loaded{ false };
+
+  std::FILE* source{ nullptr };
+  std::vector<char> text;
+  size_t text_begin{ 0 };
+  size_t text_end{ 0 };
+  size_t line{ 0 };
+  bool eof{ false };
+  bool in_comment{ false };
+};
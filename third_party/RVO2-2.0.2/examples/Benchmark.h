@@ -0,0 +1,110 @@
+/*
+ * Benchmark.h
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+
+/*
+ * Timing of the benchmark builds of the examples, which are compiled with
+ * RVO_BENCHMARK set to 1. A benchmark build scales the agent counts of its
+ * example by RVO_BENCHMARK_SCALE, stops after RVO_BENCHMARK_STEPS steps at
+ * the latest, and writes the wall clock time of the setup and of the calls to
+ * doStep as a JSON object, to the file named by its first argument if there is
+ * one or to the standard output otherwise. The results are compared against a
+ * baseline by compare_benchmarks.py.
+ */
+
+#ifndef RVO_BENCHMARK_H_
+#define RVO_BENCHMARK_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include <RVO.h>
+
+class Benchmark {
+public:
+	explicit Benchmark(const char *name) : name_(name), setupSeconds_(0.0), start_(std::chrono::steady_clock::now()) { }
+
+	void endSetup()
+	{
+		setupSeconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+	}
+
+	void beginStep()
+	{
+		start_ = std::chrono::steady_clock::now();
+	}
+
+	void endStep()
+	{
+		stepSeconds_.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+	}
+
+	size_t getNumSteps() const
+	{
+		return stepSeconds_.size();
+	}
+
+	bool write(const RVO::RVOSimulator *sim, const char *fileName) const
+	{
+		std::vector<double> sorted(stepSeconds_);
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0.0;
+
+		for (size_t i = 0; i < sorted.size(); ++i) {
+			total += sorted[i];
+		}
+
+		std::FILE *file = fileName != NULL ? std::fopen(fileName, "w") : stdout;
+
+		if (file == NULL) {
+			std::perror(fileName);
+			return false;
+		}
+
+		std::fprintf(file, "{\"benchmark\": \"%s\", \"agents\": %lu, \"obstacleVertices\": %lu, \"steps\": %lu, "
+					 "\"setupSeconds\": %.6f, \"stepSeconds\": %.6f, \"stepMedianSeconds\": %.9f, \"stepP95Seconds\": %.9f, \"stepMaxSeconds\": %.9f}\n",
+					 name_, static_cast<unsigned long>(sim->getNumAgents()), static_cast<unsigned long>(sim->getNumObstacleVertices()), static_cast<unsigned long>(sorted.size()),
+					 setupSeconds_, total, percentile(sorted, 0.5), percentile(sorted, 0.95), sorted.empty() ? 0.0 : sorted.back());
+
+		return fileName == NULL || std::fclose(file) == 0;
+	}
+
+private:
+	static double percentile(const std::vector<double> &sorted, double p)
+	{
+		if (sorted.empty()) {
+			return 0.0;
+		}
+
+		return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+	}
+
+	const char *name_;
+	double setupSeconds_;
+	std::chrono::steady_clock::time_point start_;
+	std::vector<double> stepSeconds_;
+};
+
+#endif /* RVO_BENCHMARK_H_ */
@@ -41,6 +41,18 @@
 #define RVO_OUTPUT_TIME_AND_POSITIONS 1
 #endif
 
+#ifndef RVO_BENCHMARK
+#define RVO_BENCHMARK 0
+#endif
+
+#ifndef RVO_BENCHMARK_SCALE
+#define RVO_BENCHMARK_SCALE 1
+#endif
+
+#ifndef RVO_BENCHMARK_STEPS
+#define RVO_BENCHMARK_STEPS 2000
+#endif
+
 #ifndef RVO_SEED_RANDOM_NUMBER_GENERATOR
 #define RVO_SEED_RANDOM_NUMBER_GENERATOR 1
 #endif
@@ -64,6 +76,10 @@
 
 #include <RVO.h>
 
+#if RVO_BENCHMARK
+#include "Benchmark.h"
+#endif
+
 #ifndef M_PI
 const float M_PI = 3.14159265358979323846f;
 #endif
@@ -87,8 +103,8 @@ void setupScenario(RVO::RVOSimulator *sim)
 	 * Add agents, specifying their start position, and store their goals on the
 	 * opposite side of the environment.
 	 */
-	for (size_t i = 0; i < 5; ++i) {
-		for (size_t j = 0; j < 5; ++j) {
+	for (size_t i = 0; i < 5 * RVO_BENCHMARK_SCALE; ++i) {
+		for (size_t j = 0; j < 5 * RVO_BENCHMARK_SCALE; ++j) {
 			sim->addAgent(RVO::Vector2(55.0f + i * 10.0f,  55.0f + j * 10.0f));
 			goals.push_back(RVO::Vector2(-75.0f, -75.0f));
 
@@ -194,23 +210,49 @@ bool reachedGoal(RVO::RVOSimulator *sim)
 	return true;
 }
 
+#if RVO_BENCHMARK
+int main(int argc, char *argv[])
+#else
 int main()
+#endif
 {
+#if RVO_BENCHMARK
+	Benchmark benchmark("Blocks");
+#endif
+
 	/* Create a new simulator instance. */
 	RVO::RVOSimulator *sim = new RVO::RVOSimulator();
 
 	/* Set up the scenario. */
 	setupScenario(sim);
 
+#if RVO_BENCHMARK
+	benchmark.endSetup();
+#endif
+
 	/* Perform (and manipulate) the simulation. */
 	do {
 #if RVO_OUTPUT_TIME_AND_POSITIONS
 		updateVisualization(sim);
 #endif
 		setPreferredVelocities(sim);
+#if RVO_BENCHMARK
+		benchmark.beginStep();
+#endif
 		sim->doStep();
+#if RVO_BENCHMARK
+		benchmark.endStep();
+#endif
+	}
+#if RVO_BENCHMARK
+	while (!reachedGoal(sim) && benchmark.getNumSteps() < RVO_BENCHMARK_STEPS);
+
+	if (!benchmark.write(sim, argc > 1 ? argv[1] : NULL)) {
+		return 1;
 	}
+#else
 	while (!reachedGoal(sim));
+#endif
 
 	delete sim;
 
@@ -0,0 +1,76 @@
+/*
+ * BlocksScenario.h
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The scenario of the Blocks example for the tools that run it: 100 agents
+ * split in four groups in the four corners of the environment, each moving
+ * to the opposite corner through the passages between four square obstacles.
+ */
+
+#ifndef RVO_BLOCKS_SCENARIO_H_
+#define RVO_BLOCKS_SCENARIO_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <RVO.h>
+
+/* Adds the agents and obstacles of the scenario and appends the goals of the agents. */
+inline void setupBlocksScenario(RVO::RVOSimulator &sim, std::vector<RVO::Vector2> &goals)
+{
+	sim.setTimeStep(0.25f);
+	sim.setAgentDefaults(15.0f, 10, 5.0f, 5.0f, 2.0f, 2.0f);
+
+	for (size_t i = 0; i < 5; ++i) {
+		for (size_t j = 0; j < 5; ++j) {
+			sim.addAgent(RVO::Vector2(55.0f + i * 10.0f, 55.0f + j * 10.0f));
+			goals.push_back(RVO::Vector2(-75.0f, -75.0f));
+
+			sim.addAgent(RVO::Vector2(-55.0f - i * 10.0f, 55.0f + j * 10.0f));
+			goals.push_back(RVO::Vector2(75.0f, -75.0f));
+
+			sim.addAgent(RVO::Vector2(55.0f + i * 10.0f, -55.0f - j * 10.0f));
+			goals.push_back(RVO::Vector2(-75.0f, 75.0f));
+
+			sim.addAgent(RVO::Vector2(-55.0f - i * 10.0f, -55.0f - j * 10.0f));
+			goals.push_back(RVO::Vector2(75.0f, 75.0f));
+		}
+	}
+
+	const float blocks[4][4][2] = {
+		{ { -10.0f, 40.0f }, { -40.0f, 40.0f }, { -40.0f, 10.0f }, { -10.0f, 10.0f } },
+		{ { 10.0f, 40.0f }, { 10.0f, 10.0f }, { 40.0f, 10.0f }, { 40.0f, 40.0f } },
+		{ { 10.0f, -40.0f }, { 40.0f, -40.0f }, { 40.0f, -10.0f }, { 10.0f, -10.0f } },
+		{ { -10.0f, -40.0f }, { -10.0f, -10.0f }, { -40.0f, -10.0f }, { -40.0f, -40.0f } }
+	};
+
+	for (size_t i = 0; i < 4; ++i) {
+		std::vector<RVO::Vector2> obstacle;
+
+		for (size_t j = 0; j < 4; ++j) {
+			obstacle.push_back(RVO::Vector2(blocks[i][j][0], blocks[i][j][1]));
+		}
+
+		sim.addObstacle(obstacle);
+	}
+
+	sim.processObstacles();
+}
+
+#endif /* RVO_BLOCKS_SCENARIO_H_ */
@@ -0,0 +1,97 @@
+/*
+ * Churn.cpp
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Example tool that checks that a long-running stream of agents has a
+ * constant cost. Agents with their own parameters are added on one side of
+ * a pool and removed on the other, and some get a property set on their own.
+ * The simulation is saved and restored halfway. The tool exits with 1 when
+ * the number of agent profiles grows beyond what the agents in the pool can
+ * use at once.
+ *
+ * Usage: Churn [numSteps [poolSize]]
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <RVO.h>
+
+int main(int argc, char *argv[])
+{
+	const size_t numSteps = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 2000;
+	const size_t poolSize = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 50;
+
+	RVO::RVOSimulator sim;
+	sim.setTimeStep(0.25f);
+	sim.setAgentDefaults(15.0f, 10, 5.0f, 5.0f, 2.0f, 2.0f);
+
+	/* The pool agents with their own profiles, the default profile and its replacement. */
+	const size_t maxProfiles = 2 * poolSize + 2;
+	size_t peakProfiles = 0;
+
+	for (size_t step = 0; step < numSteps; ++step) {
+		/* Every agent gets a radius of its own, so that none share a profile. */
+		const float radius = 1.0f + 0.001f * static_cast<float>(step % 500);
+		sim.addAgent(RVO::Vector2(-100.0f, 5.0f * static_cast<float>(step % 20)), 15.0f, 10, 5.0f, 5.0f, radius, 2.0f);
+
+		if (step % 3 == 0) {
+			sim.setAgentMaxSpeed(sim.getNumAgents() - 1, 3.0f);
+		}
+
+		/* The oldest agent leaves the pool. */
+		while (sim.getNumAgents() > poolSize) {
+			sim.removeAgent(0);
+		}
+
+		if (step == numSteps / 2) {
+			/* The default profile changes once, which keeps the old one for the agents that use it. */
+			sim.setAgentDefaults(15.0f, 10, 5.0f, 5.0f, 1.5f, 2.0f);
+
+			std::vector<char> state;
+			sim.saveState(state);
+
+			if (!sim.loadState(state)) {
+				std::cerr << "Cannot restore the saved state" << std::endl;
+				return 1;
+			}
+		}
+
+		for (size_t i = 0; i < sim.getNumAgents(); ++i) {
+			sim.setAgentPrefVelocity(i, RVO::Vector2(1.0f, 0.0f));
+		}
+
+		sim.doStep();
+
+		if (sim.getNumAgentProfiles() > peakProfiles) {
+			peakProfiles = sim.getNumAgentProfiles();
+		}
+	}
+
+	std::cout << numSteps << " agents added, " << sim.getNumAgents() << " in the pool, at most " << peakProfiles << " agent profiles" << std::endl;
+
+	if (peakProfiles > maxProfiles) {
+		std::cerr << "The agent profiles grew beyond " << maxProfiles << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -40,6 +40,18 @@
 #define RVO_OUTPUT_TIME_AND_POSITIONS 1
 #endif
 
+#ifndef RVO_BENCHMARK
+#define RVO_BENCHMARK 0
+#endif
+
+#ifndef RVO_BENCHMARK_SCALE
+#define RVO_BENCHMARK_SCALE 1
+#endif
+
+#ifndef RVO_BENCHMARK_STEPS
+#define RVO_BENCHMARK_STEPS 2000
+#endif
+
 #include <cmath>
 #include <cstddef>
 #include <vector>
@@ -54,6 +66,10 @@
 
 #include <RVO.h>
 
+#if RVO_BENCHMARK
+#include "Benchmark.h"
+#endif
+
 #ifndef M_PI
 const float M_PI = 3.14159265358979323846f;
 #endif
@@ -73,10 +89,10 @@ void setupScenario(RVO::RVOSimulator *sim)
 	 * Add agents, specifying their start position, and store their goals on the
 	 * opposite side of the environment.
 	 */
-	for (size_t i = 0; i < 250; ++i) {
-		sim->addAgent(200.0f *
-		              RVO::Vector2(std::cos(i * 2.0f * M_PI / 250.0f),
-		                           std::sin(i * 2.0f * M_PI / 250.0f)));
+	for (size_t i = 0; i < 250 * RVO_BENCHMARK_SCALE; ++i) {
+		sim->addAgent(200.0f * RVO_BENCHMARK_SCALE *
+		              RVO::Vector2(std::cos(i * 2.0f * M_PI / (250.0f * RVO_BENCHMARK_SCALE)),
+		                           std::sin(i * 2.0f * M_PI / (250.0f * RVO_BENCHMARK_SCALE))));
 		goals.push_back(-sim->getAgentPosition(i));
 	}
 }
@@ -128,23 +144,49 @@ bool reachedGoal(RVO::RVOSimulator *sim)
 	return true;
 }
 
+#if RVO_BENCHMARK
+int main(int argc, char *argv[])
+#else
 int main()
+#endif
 {
+#if RVO_BENCHMARK
+	Benchmark benchmark("Circle");
+#endif
+
 	/* Create a new simulator instance. */
 	RVO::RVOSimulator *sim = new RVO::RVOSimulator();
 
 	/* Set up the scenario. */
 	setupScenario(sim);
 
+#if RVO_BENCHMARK
+	benchmark.endSetup();
+#endif
+
 	/* Perform (and manipulate) the simulation. */
 	do {
 #if RVO_OUTPUT_TIME_AND_POSITIONS
 		updateVisualization(sim);
 #endif
 		setPreferredVelocities(sim);
+#if RVO_BENCHMARK
+		benchmark.beginStep();
+#endif
 		sim->doStep();
+#if RVO_BENCHMARK
+		benchmark.endStep();
+#endif
+	}
+#if RVO_BENCHMARK
+	while (!reachedGoal(sim) && benchmark.getNumSteps() < RVO_BENCHMARK_STEPS);
+
+	if (!benchmark.write(sim, argc > 1 ? argv[1] : NULL)) {
+		return 1;
 	}
+#else
 	while (!reachedGoal(sim));
+#endif
 
 	delete sim;
 
@@ -0,0 +1,342 @@
+/*
+ * Ensemble.cpp
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Example file showing a parameter study that runs many independent
+ * simulations of the circle scenario in parallel. Each simulation is small and
+ * runs on a single thread; the simulations are distributed over one worker
+ * thread per core. The parameter grid is read from a file with one parameter
+ * per line followed by the values to sweep, for example:
+ *
+ *     timeHorizon 5 10 20
+ *     neighborDist 10 15
+ *
+ * Every combination of values is run once. Parameters that are not listed keep
+ * their default value. The metrics of each run (steps taken, time until all
+ * agents reached their goals or -1 if they did not within maxSteps, minimum
+ * distance between the boundaries of any two agents and wall clock time) are
+ * written as comma-separated values, to the output file if one is specified or
+ * to the standard output otherwise.
+ *
+ * Usage: Ensemble [gridFile [outputFile [numThreads]]]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if _OPENMP
+#include <omp.h>
+#endif
+
+#include <RVO.h>
+
+#ifndef M_PI
+const float M_PI = 3.14159265358979323846f;
+#endif
+
+/* The parameters of a run. */
+enum Parameter {
+	NUM_AGENTS,
+	CIRCLE_RADIUS,
+	NEIGHBOR_DIST,
+	MAX_NEIGHBORS,
+	TIME_HORIZON,
+	TIME_HORIZON_OBST,
+	RADIUS,
+	MAX_SPEED,
+	TIME_STEP,
+	MAX_STEPS,
+	NUM_PARAMETERS
+};
+
+const char *const PARAMETER_NAMES[NUM_PARAMETERS] = {
+	"numAgents", "circleRadius", "neighborDist", "maxNeighbors", "timeHorizon",
+	"timeHorizonObst", "radius", "maxSpeed", "timeStep", "maxSteps"
+};
+
+/* The defaults match the circle example. */
+const float PARAMETER_DEFAULTS[NUM_PARAMETERS] = {
+	250.0f, 200.0f, 15.0f, 10.0f, 10.0f, 10.0f, 1.5f, 2.0f, 0.25f, 10000.0f
+};
+
+/* The metrics of a run. */
+struct RunMetrics {
+	size_t steps;
+	float timeToGoals;
+	float minSeparation;
+	double wallTime;
+};
+
+bool readGrid(std::istream &input, std::vector<std::vector<float> > &grid)
+{
+	grid.assign(NUM_PARAMETERS, std::vector<float>());
+
+	std::string line;
+
+	while (std::getline(input, line)) {
+		std::istringstream stream(line);
+		std::string name;
+
+		if (!(stream >> name) || name[0] == '#') {
+			continue;
+		}
+
+		const size_t parameter = std::find(PARAMETER_NAMES, PARAMETER_NAMES + NUM_PARAMETERS, name) - PARAMETER_NAMES;
+
+		if (parameter == NUM_PARAMETERS) {
+			std::cerr << "Unknown parameter " << name << std::endl;
+			return false;
+		}
+
+		float value;
+
+		while (stream >> value) {
+			grid[parameter].push_back(value);
+		}
+
+		if (!stream.eof() || grid[parameter].empty()) {
+			std::cerr << "Invalid values for parameter " << name << std::endl;
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < NUM_PARAMETERS; ++i) {
+		if (grid[i].empty()) {
+			grid[i].push_back(PARAMETER_DEFAULTS[i]);
+		}
+	}
+
+	return true;
+}
+
+void expandGrid(const std::vector<std::vector<float> > &grid, std::vector<std::vector<float> > &runs)
+{
+	runs.assign(1, std::vector<float>());
+
+	for (size_t i = 0; i < NUM_PARAMETERS; ++i) {
+		std::vector<std::vector<float> > expanded;
+
+		for (size_t j = 0; j < runs.size(); ++j) {
+			for (size_t k = 0; k < grid[i].size(); ++k) {
+				expanded.push_back(runs[j]);
+				expanded.back().push_back(grid[i][k]);
+			}
+		}
+
+		runs.swap(expanded);
+	}
+}
+
+void runSimulation(const std::vector<float> &parameters, RunMetrics &metrics)
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	const size_t numAgents = static_cast<size_t>(parameters[NUM_AGENTS]);
+	const size_t maxSteps = static_cast<size_t>(parameters[MAX_STEPS]);
+
+	RVO::RVOSimulator sim;
+	sim.setTimeStep(parameters[TIME_STEP]);
+	sim.setAgentDefaults(parameters[NEIGHBOR_DIST], static_cast<size_t>(parameters[MAX_NEIGHBORS]), parameters[TIME_HORIZON], parameters[TIME_HORIZON_OBST], parameters[RADIUS], parameters[MAX_SPEED]);
+
+	std::vector<RVO::Vector2> goals;
+
+	for (size_t i = 0; i < numAgents; ++i) {
+		sim.addAgent(parameters[CIRCLE_RADIUS] *
+		             RVO::Vector2(std::cos(i * 2.0f * M_PI / numAgents),
+		                          std::sin(i * 2.0f * M_PI / numAgents)));
+		goals.push_back(-sim.getAgentPosition(i));
+	}
+
+	std::vector<RVO::Vector2> positions(numAgents);
+	std::vector<std::vector<size_t> > nearest;
+
+	metrics.steps = 0;
+	metrics.timeToGoals = -1.0f;
+	metrics.minSeparation = std::numeric_limits<float>::infinity();
+
+	while (metrics.steps < maxSteps) {
+		bool reachedGoals = true;
+
+		for (size_t i = 0; i < numAgents; ++i) {
+			RVO::Vector2 goalVector = goals[i] - sim.getAgentPosition(i);
+
+			if (RVO::absSq(goalVector) > sim.getAgentRadius(i) * sim.getAgentRadius(i)) {
+				reachedGoals = false;
+			}
+
+			if (RVO::absSq(goalVector) > 1.0f) {
+				goalVector = RVO::normalize(goalVector);
+			}
+
+			sim.setAgentPrefVelocity(i, goalVector);
+		}
+
+		if (reachedGoals) {
+			metrics.timeToGoals = sim.getGlobalTime();
+			break;
+		}
+
+		sim.doStep();
+		++metrics.steps;
+
+		/* The separation is the distance between the boundaries of the nearest agents. */
+		for (size_t i = 0; i < numAgents; ++i) {
+			positions[i] = sim.getAgentPosition(i);
+		}
+
+		sim.queryNearestAgents(positions, 2, nearest);
+
+		for (size_t i = 0; i < numAgents; ++i) {
+			for (size_t j = 0; j < nearest[i].size(); ++j) {
+				if (nearest[i][j] != i) {
+					const float separation = RVO::abs(positions[nearest[i][j]] - positions[i]) - sim.getAgentRadius(i) - sim.getAgentRadius(nearest[i][j]);
+					metrics.minSeparation = std::min(metrics.minSeparation, separation);
+					break;
+				}
+			}
+		}
+	}
+
+	metrics.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void runWorker(const std::vector<std::vector<float> > *runs, const std::vector<size_t> *order, std::atomic<size_t> *next, std::vector<RunMetrics> *metrics)
+{
+#if _OPENMP
+	/* The runs are the unit of parallelism, so each simulation uses one thread. */
+	omp_set_num_threads(1);
+#endif
+
+	for (size_t i = (*next)++; i < order->size(); i = (*next)++) {
+		runSimulation((*runs)[(*order)[i]], (*metrics)[(*order)[i]]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::vector<float> > grid;
+
+	if (argc > 1) {
+		std::ifstream gridFile(argv[1]);
+
+		if (!gridFile) {
+			std::cerr << "Cannot open grid file " << argv[1] << std::endl;
+			return 1;
+		}
+
+		if (!readGrid(gridFile, grid)) {
+			return 1;
+		}
+	}
+	else {
+		std::istringstream defaultGrid("timeHorizon 5 10\nneighborDist 10 15\n");
+		readGrid(defaultGrid, grid);
+	}
+
+	std::vector<std::vector<float> > runs;
+	expandGrid(grid, runs);
+
+	size_t numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	if (argc > 3) {
+		numThreads = std::max(std::atoi(argv[3]), 1);
+	}
+
+	/* Start the most expensive runs first so that the workers finish together. */
+	std::vector<std::pair<float, size_t> > costs;
+
+	for (size_t i = 0; i < runs.size(); ++i) {
+		costs.push_back(std::make_pair(-runs[i][NUM_AGENTS] * runs[i][MAX_NEIGHBORS] / runs[i][TIME_STEP], i));
+	}
+
+	std::sort(costs.begin(), costs.end());
+
+	std::vector<size_t> order;
+
+	for (size_t i = 0; i < costs.size(); ++i) {
+		order.push_back(costs[i].second);
+	}
+
+	std::vector<RunMetrics> metrics(runs.size());
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < std::min(numThreads, runs.size()); ++i) {
+		workers.push_back(std::thread(runWorker, &runs, &order, &next, &metrics));
+	}
+
+	for (size_t i = 0; i < workers.size(); ++i) {
+		workers[i].join();
+	}
+
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::ofstream outputFile;
+
+	if (argc > 2) {
+		outputFile.open(argv[2]);
+
+		if (!outputFile) {
+			std::cerr << "Cannot open output file " << argv[2] << std::endl;
+			return 1;
+		}
+	}
+
+	std::ostream &output = (argc > 2 ? outputFile : std::cout);
+
+	output << "run";
+
+	for (size_t i = 0; i < NUM_PARAMETERS; ++i) {
+		output << "," << PARAMETER_NAMES[i];
+	}
+
+	output << ",steps,timeToGoals,minSeparation,wallTime" << std::endl;
+
+	double totalTime = 0.0;
+
+	for (size_t i = 0; i < runs.size(); ++i) {
+		output << i;
+
+		for (size_t j = 0; j < NUM_PARAMETERS; ++j) {
+			output << "," << runs[i][j];
+		}
+
+		output << "," << metrics[i].steps << "," << metrics[i].timeToGoals << "," << metrics[i].minSeparation << "," << metrics[i].wallTime << std::endl;
+
+		totalTime += metrics[i].wallTime;
+	}
+
+	std::cerr << runs.size() << " runs on " << workers.size() << " threads in " << elapsed << " s (" << runs.size() / elapsed << " runs/s, " << totalTime / runs.size() << " s per run)" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,339 @@
+/*
+ * Golden.cpp
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Example tool that verifies an optimized build of the library against a
+ * reference build. In record mode, a scenario is run with the reference build
+ * and its golden trajectory is written: the positions and velocities of all
+ * agents and their sorted agent and obstacle neighbor sets after every step.
+ * In check mode, the same scenario is run with the build under test in
+ * lockstep with the golden trajectory. For every step, the maximum position
+ * divergence, the agent at which it occurs and the number of agents whose
+ * neighbor sets differ are written as comma-separated values, followed by the
+ * first step and agent that diverged by more than the tolerance or whose
+ * neighbor sets differed. With resync set to 1, the agents are reset to their
+ * golden positions and velocities after every step, so that the divergence
+ * measures a single step of the kernels instead of accumulating over the run.
+ *
+ * Usage: Golden record scenario goldenFile [numSteps]
+ *        Golden check scenario goldenFile [tolerance [maxNeighborDifferences [resync]]]
+ *
+ * The scenario is circle, blocks or a file written by RVOSimulator::saveState,
+ * whose agents keep their saved preferred velocities. Check mode exits with 1
+ * when an agent diverged by more than the tolerance (default 0) or when more
+ * than maxNeighborDifferences agents (default 0) had different neighbor sets
+ * in a step.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <RVO.h>
+
+#include "BlocksScenario.h"
+
+#ifndef M_PI
+const float M_PI = 3.14159265358979323846f;
+#endif
+
+const unsigned int GOLDEN_MAGIC = 0x474f5652;
+const unsigned int GOLDEN_VERSION = 1;
+
+/* The state of one agent after a step. */
+struct AgentState {
+	RVO::Vector2 position;
+	RVO::Vector2 velocity;
+	std::vector<unsigned int> agentNeighbors;
+	std::vector<unsigned int> obstacleNeighbors;
+};
+
+/* The goals of the agents, or empty when the preferred velocities are kept. */
+std::vector<RVO::Vector2> goals;
+
+bool setupScenario(RVO::RVOSimulator &sim, const std::string &scenario)
+{
+	if (scenario == "circle") {
+		sim.setTimeStep(0.25f);
+		sim.setAgentDefaults(15.0f, 10, 10.0f, 10.0f, 1.5f, 2.0f);
+
+		for (size_t i = 0; i < 250; ++i) {
+			sim.addAgent(200.0f * RVO::Vector2(std::cos(i * 2.0f * M_PI / 250.0f), std::sin(i * 2.0f * M_PI / 250.0f)));
+			goals.push_back(-sim.getAgentPosition(i));
+		}
+
+		return true;
+	}
+
+	if (scenario == "blocks") {
+		setupBlocksScenario(sim, goals);
+
+		return true;
+	}
+
+	if (!sim.loadState(scenario)) {
+		std::cerr << "Unknown scenario or invalid state file " << scenario << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void setPreferredVelocities(RVO::RVOSimulator &sim)
+{
+	for (size_t i = 0; i < goals.size(); ++i) {
+		RVO::Vector2 goalVector = goals[i] - sim.getAgentPosition(i);
+
+		if (RVO::absSq(goalVector) > 1.0f) {
+			goalVector = RVO::normalize(goalVector);
+		}
+
+		sim.setAgentPrefVelocity(i, goalVector);
+	}
+}
+
+void getAgentState(const RVO::RVOSimulator &sim, size_t agentNo, AgentState &state)
+{
+	state.position = sim.getAgentPosition(agentNo);
+	state.velocity = sim.getAgentVelocity(agentNo);
+
+	/* Neighbors are compared as sets, since optimized kernels may reorder them. */
+	state.agentNeighbors.resize(sim.getAgentNumAgentNeighbors(agentNo));
+
+	for (size_t i = 0; i < state.agentNeighbors.size(); ++i) {
+		state.agentNeighbors[i] = static_cast<unsigned int>(sim.getAgentAgentNeighbor(agentNo, i));
+	}
+
+	std::sort(state.agentNeighbors.begin(), state.agentNeighbors.end());
+
+	state.obstacleNeighbors.resize(sim.getAgentNumObstacleNeighbors(agentNo));
+
+	for (size_t i = 0; i < state.obstacleNeighbors.size(); ++i) {
+		state.obstacleNeighbors[i] = static_cast<unsigned int>(sim.getAgentObstacleNeighbor(agentNo, i));
+	}
+
+	std::sort(state.obstacleNeighbors.begin(), state.obstacleNeighbors.end());
+}
+
+template <typename T>
+void writeValue(std::ostream &output, const T &value)
+{
+	output.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::istream &input, T &value)
+{
+	return static_cast<bool>(input.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+void writeIndices(std::ostream &output, const std::vector<unsigned int> &indices)
+{
+	writeValue(output, static_cast<unsigned int>(indices.size()));
+
+	if (!indices.empty()) {
+		output.write(reinterpret_cast<const char *>(&indices[0]), indices.size() * sizeof(unsigned int));
+	}
+}
+
+bool readIndices(std::istream &input, std::vector<unsigned int> &indices)
+{
+	unsigned int size;
+
+	if (!readValue(input, size)) {
+		return false;
+	}
+
+	indices.resize(size);
+
+	return size == 0 || static_cast<bool>(input.read(reinterpret_cast<char *>(&indices[0]), size * sizeof(unsigned int)));
+}
+
+void writeAgentState(std::ostream &output, const AgentState &state)
+{
+	writeValue(output, state.position);
+	writeValue(output, state.velocity);
+	writeIndices(output, state.agentNeighbors);
+	writeIndices(output, state.obstacleNeighbors);
+}
+
+bool readAgentState(std::istream &input, AgentState &state)
+{
+	return readValue(input, state.position) && readValue(input, state.velocity) &&
+	       readIndices(input, state.agentNeighbors) && readIndices(input, state.obstacleNeighbors);
+}
+
+int record(RVO::RVOSimulator &sim, const char *fileName, unsigned int numSteps)
+{
+	std::ofstream output(fileName, std::ios::binary);
+
+	if (!output) {
+		std::cerr << "Cannot open golden file " << fileName << std::endl;
+		return 1;
+	}
+
+	writeValue(output, GOLDEN_MAGIC);
+	writeValue(output, GOLDEN_VERSION);
+	writeValue(output, static_cast<unsigned int>(sim.getNumAgents()));
+	writeValue(output, static_cast<unsigned int>(sim.getNumObstacleVertices()));
+	writeValue(output, numSteps);
+
+	AgentState state;
+
+	for (unsigned int step = 0; step < numSteps; ++step) {
+		setPreferredVelocities(sim);
+		sim.doStep();
+
+		for (size_t i = 0; i < sim.getNumAgents(); ++i) {
+			getAgentState(sim, i, state);
+			writeAgentState(output, state);
+		}
+	}
+
+	if (!output.flush()) {
+		std::cerr << "Cannot write golden file " << fileName << std::endl;
+		return 1;
+	}
+
+	std::cerr << "Recorded " << numSteps << " steps of " << sim.getNumAgents() << " agents" << std::endl;
+
+	return 0;
+}
+
+int check(RVO::RVOSimulator &sim, const char *fileName, float tolerance, size_t maxNeighborDifferences, bool resync)
+{
+	std::ifstream input(fileName, std::ios::binary);
+
+	if (!input) {
+		std::cerr << "Cannot open golden file " << fileName << std::endl;
+		return 1;
+	}
+
+	unsigned int magic, version, numAgents, numObstacleVertices, numSteps;
+
+	if (!readValue(input, magic) || magic != GOLDEN_MAGIC || !readValue(input, version) || version != GOLDEN_VERSION ||
+	    !readValue(input, numAgents) || !readValue(input, numObstacleVertices) || !readValue(input, numSteps)) {
+		std::cerr << "Invalid golden file " << fileName << std::endl;
+		return 1;
+	}
+
+	if (numAgents != sim.getNumAgents() || numObstacleVertices != sim.getNumObstacleVertices()) {
+		std::cerr << "The golden file was recorded with " << numAgents << " agents and " << numObstacleVertices
+		          << " obstacle vertices, the scenario has " << sim.getNumAgents() << " and " << sim.getNumObstacleVertices() << std::endl;
+		return 1;
+	}
+
+	bool diverged = false;
+	unsigned int firstStep = 0;
+	size_t firstAgent = 0;
+	float maxDivergence = 0.0f;
+	size_t maxNeighborDifferencesSeen = 0;
+
+	AgentState golden, state;
+
+	std::cout << "step,maxDivergence,agent,neighborDifferences" << std::endl;
+
+	for (unsigned int step = 0; step < numSteps; ++step) {
+		setPreferredVelocities(sim);
+		sim.doStep();
+
+		float stepDivergence = 0.0f;
+		size_t stepAgent = 0;
+		size_t neighborDifferences = 0;
+
+		for (size_t i = 0; i < numAgents; ++i) {
+			if (!readAgentState(input, golden)) {
+				std::cerr << "Golden file " << fileName << " ends at step " << step << std::endl;
+				return 1;
+			}
+
+			getAgentState(sim, i, state);
+
+			const float divergence = RVO::abs(state.position - golden.position);
+			const bool neighborsDiffer = state.agentNeighbors != golden.agentNeighbors || state.obstacleNeighbors != golden.obstacleNeighbors;
+
+			/* Comparisons are written so that NaN positions count as divergent. */
+			if (!(divergence <= stepDivergence)) {
+				stepDivergence = divergence;
+				stepAgent = i;
+			}
+
+			if (neighborsDiffer) {
+				++neighborDifferences;
+			}
+
+			if (!diverged && (!(divergence <= tolerance) || neighborsDiffer)) {
+				diverged = true;
+				firstStep = step;
+				firstAgent = i;
+			}
+
+			if (resync) {
+				sim.setAgentPosition(i, golden.position);
+				sim.setAgentVelocity(i, golden.velocity);
+			}
+		}
+
+		std::cout << step << "," << stepDivergence << "," << stepAgent << "," << neighborDifferences << std::endl;
+
+		if (!(stepDivergence <= maxDivergence)) {
+			maxDivergence = stepDivergence;
+		}
+
+		maxNeighborDifferencesSeen = std::max(maxNeighborDifferencesSeen, neighborDifferences);
+	}
+
+	std::cerr << "Checked " << numSteps << " steps of " << numAgents << " agents" << (resync ? " with resync" : "")
+	          << ": max divergence " << maxDivergence << ", at most " << maxNeighborDifferencesSeen << " agents with different neighbors per step" << std::endl;
+
+	if (diverged) {
+		std::cerr << "First divergence at step " << firstStep << ", agent " << firstAgent << std::endl;
+	}
+
+	return !(maxDivergence <= tolerance) || maxNeighborDifferencesSeen > maxNeighborDifferences ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4 || (std::strcmp(argv[1], "record") != 0 && std::strcmp(argv[1], "check") != 0)) {
+		std::cerr << "Usage: Golden record scenario goldenFile [numSteps]" << std::endl;
+		std::cerr << "       Golden check scenario goldenFile [tolerance [maxNeighborDifferences [resync]]]" << std::endl;
+		return 1;
+	}
+
+	RVO::RVOSimulator sim;
+
+	if (!setupScenario(sim, argv[2])) {
+		return 1;
+	}
+
+	if (std::strcmp(argv[1], "record") == 0) {
+		return record(sim, argv[3], argc > 4 ? static_cast<unsigned int>(std::atoi(argv[4])) : 1000);
+	}
+
+	return check(sim, argv[3], argc > 4 ? static_cast<float>(std::atof(argv[4])) : 0.0f,
+	             argc > 5 ? static_cast<size_t>(std::atoi(argv[5])) : 0, argc > 6 && std::atoi(argv[6]) != 0);
+}
@@ -0,0 +1,264 @@
+/*
+ * LPReplay.cpp
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Example tool that replays a corpus of linear programs captured from a
+ * simulation with ConstraintCapture against the linear program
+ * implementations listed in SOLVERS. For every implementation, the number of
+ * results that differ from the velocities the simulation computed by more
+ * than a tolerance, the largest difference, the one-dimensional linear
+ * programs per solve and the time per solve, the best of several repetitions
+ * over the whole corpus, are written as a table.
+ * Without a corpus file, a corpus is captured from the blocks scenario and
+ * written to LPReplay.corpus first. The tool exits with 1 when the reference
+ * implementation does not reproduce the captured velocities.
+ *
+ * The solvers marked as random order run on a copy of the corpus whose agent
+ * lines were shuffled like those of RVOSimulator::setLinearProgramRandomOrder.
+ *
+ * Usage: LPReplay [corpusFile [repetitions]]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <RVO.h>
+#include <ConstraintCapture.h>
+
+#include "Agent.h"
+#include "BlocksScenario.h"
+
+/* Results that differ by more than this are counted as mismatches. */
+const float TOLERANCE = 1e-4f;
+
+/* Computes the new velocity of a captured linear program. */
+typedef void (*Solver)(const RVO::ConstraintRecord &record, RVO::Vector2 &result, RVO::SolverStats &stats);
+
+/* Scratch lines for linearProgram3. */
+std::vector<RVO::Line> projLines;
+
+/* The linear program of Agent::computeNewVelocity. */
+void solveReference(const RVO::ConstraintRecord &record, RVO::Vector2 &result, RVO::SolverStats &stats)
+{
+	const size_t lineFail = RVO::linearProgram2(record.lines, record.maxSpeed, record.prefVelocity, false, result, stats);
+
+	if (lineFail < record.lines.size()) {
+		RVO::linearProgram3(record.lines, record.numObstLines, lineFail, record.maxSpeed, result, projLines, stats);
+	}
+}
+
+/* linearProgram3 as it was before it reused scratch lines, allocating them for every violated line. */
+void linearProgram3Allocating(const std::vector<RVO::Line> &lines, size_t numObstLines, size_t beginLine, float radius, RVO::Vector2 &result, RVO::SolverStats &stats)
+{
+	float distance = 0.0f;
+
+	for (size_t i = beginLine; i < lines.size(); ++i) {
+		if (RVO::det(lines[i].direction, lines[i].point - result) > distance) {
+			std::vector<RVO::Line> projLines(lines.begin(), lines.begin() + static_cast<ptrdiff_t>(numObstLines));
+
+			for (size_t j = numObstLines; j < i; ++j) {
+				RVO::Line line;
+
+				float determinant = RVO::det(lines[i].direction, lines[j].direction);
+
+				if (std::fabs(determinant) <= RVO_EPSILON) {
+					if (lines[i].direction * lines[j].direction > 0.0f) {
+						continue;
+					}
+					else {
+						line.point = 0.5f * (lines[i].point + lines[j].point);
+					}
+				}
+				else {
+					line.point = lines[i].point + (RVO::det(lines[j].direction, lines[i].point - lines[j].point) / determinant) * lines[i].direction;
+				}
+
+				line.direction = RVO::normalize(lines[j].direction - lines[i].direction);
+				projLines.push_back(line);
+			}
+
+			const RVO::Vector2 tempResult = result;
+
+			if (RVO::linearProgram2(projLines, radius, RVO::Vector2(-lines[i].direction.y(), lines[i].direction.x()), true, result, stats) < projLines.size()) {
+				result = tempResult;
+			}
+
+			distance = RVO::det(lines[i].direction, lines[i].point - result);
+		}
+	}
+}
+
+void solveAllocating(const RVO::ConstraintRecord &record, RVO::Vector2 &result, RVO::SolverStats &stats)
+{
+	const size_t lineFail = RVO::linearProgram2(record.lines, record.maxSpeed, record.prefVelocity, false, result, stats);
+
+	if (lineFail < record.lines.size()) {
+		linearProgram3Allocating(record.lines, record.numObstLines, lineFail, record.maxSpeed, result, stats);
+	}
+}
+
+/* Shuffles the agent lines of a record like Agent::computeNewVelocity shuffles the agent neighbors of the agent in the slot in the step. */
+void shuffleAgentLines(RVO::ConstraintRecord &record, size_t slot, size_t step)
+{
+	unsigned int seed = static_cast<unsigned int>(slot) * 2654435761u ^ static_cast<unsigned int>(step) * 2246822519u;
+	seed ^= seed >> 15;
+	seed *= 2246822519u;
+	seed ^= seed >> 13;
+
+	for (size_t i = record.lines.size(); i > record.numObstLines + 1; --i) {
+		seed = seed * 1664525u + 1013904223u;
+		std::swap(record.lines[i - 1], record.lines[record.numObstLines + (seed >> 8) % (i - record.numObstLines)]);
+	}
+}
+
+struct SolverEntry {
+	const char *name;
+	Solver solve;
+	bool randomOrder;
+};
+
+/* The reference comes first, alternative implementations are added below it. */
+const SolverEntry SOLVERS[] = {
+	{ "reference", solveReference, false },
+	{ "allocating", solveAllocating, false },
+	{ "random order", solveReference, true }
+};
+
+const size_t NUM_SOLVERS = sizeof(SOLVERS) / sizeof(SOLVERS[0]);
+
+/* Captures every agent in every other step of the blocks example. */
+bool captureCorpus(const char *fileName)
+{
+	RVO::RVOSimulator sim;
+	std::vector<RVO::Vector2> goals;
+	setupBlocksScenario(sim, goals);
+
+	RVO::ConstraintCapture::enable(1, 2, 1000000);
+
+	for (size_t step = 0; step < 1000; ++step) {
+		for (size_t i = 0; i < sim.getNumAgents(); ++i) {
+			RVO::Vector2 goalVector = goals[i] - sim.getAgentPosition(i);
+
+			if (RVO::absSq(goalVector) > 1.0f) {
+				goalVector = RVO::normalize(goalVector);
+			}
+
+			sim.setAgentPrefVelocity(i, goalVector);
+		}
+
+		sim.doStep();
+	}
+
+	RVO::ConstraintCapture::disable();
+
+	return RVO::ConstraintCapture::write(fileName);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *fileName = argc > 1 ? argv[1] : "LPReplay.corpus";
+	const int repetitions = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 10;
+
+	if (argc < 2 && !captureCorpus(fileName)) {
+		std::fprintf(stderr, "Cannot write corpus file %s\n", fileName);
+		return 1;
+	}
+
+	std::vector<RVO::ConstraintRecord> records;
+
+	if (!RVO::ConstraintCapture::read(fileName, records) || records.empty()) {
+		std::fprintf(stderr, "Cannot read corpus file %s\n", fileName);
+		return 1;
+	}
+
+	size_t numLines = 0;
+	size_t numInfeasible = 0;
+
+	for (size_t i = 0; i < records.size(); ++i) {
+		RVO::SolverStats stats;
+		RVO::Vector2 result;
+		numLines += records[i].lines.size();
+		numInfeasible += RVO::linearProgram2(records[i].lines, records[i].maxSpeed, records[i].prefVelocity, false, result, stats) < records[i].lines.size() ? 1 : 0;
+	}
+
+	std::printf("%lu linear programs, %.1f lines on average, %lu need linearProgram3\n",
+	            static_cast<unsigned long>(records.size()), static_cast<double>(numLines) / records.size(), static_cast<unsigned long>(numInfeasible));
+	std::printf("%-16s %12s %12s %12s %12s\n", "solver", "ns/solve", "1D/solve", "mismatches", "maxError");
+
+	std::vector<RVO::ConstraintRecord> shuffledRecords(records);
+
+	for (size_t i = 0; i < shuffledRecords.size(); ++i) {
+		shuffleAgentLines(shuffledRecords[i], i, 0);
+	}
+
+	std::vector<RVO::Vector2> results(records.size());
+	int status = 0;
+
+	for (size_t i = 0; i < NUM_SOLVERS; ++i) {
+		const std::vector<RVO::ConstraintRecord> &solved = SOLVERS[i].randomOrder ? shuffledRecords : records;
+		RVO::SolverStats stats;
+		double best = 0.0;
+
+		for (int j = 0; j < repetitions; ++j) {
+			stats = RVO::SolverStats();
+
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			for (size_t k = 0; k < solved.size(); ++k) {
+				SOLVERS[i].solve(solved[k], results[k], stats);
+			}
+
+			const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (j == 0 || elapsed < best) {
+				best = elapsed;
+			}
+		}
+
+		size_t mismatches = 0;
+		float maxError = 0.0f;
+
+		for (size_t k = 0; k < records.size(); ++k) {
+			const float error = RVO::abs(results[k] - records[k].result);
+
+			/* Comparisons are written so that NaN results count as mismatches. */
+			if (!(error <= TOLERANCE)) {
+				++mismatches;
+			}
+
+			if (!(error <= maxError)) {
+				maxError = error;
+			}
+		}
+
+		std::printf("%-16s %12.1f %12.2f %12lu %12g\n", SOLVERS[i].name, best * 1e9 / records.size(), static_cast<double>(stats.linearProgram1Calls) / records.size(), static_cast<unsigned long>(mismatches), maxError);
+
+		if (i == 0 && mismatches > 0) {
+			status = 1;
+		}
+	}
+
+	return status;
+}
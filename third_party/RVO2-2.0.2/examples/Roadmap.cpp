@@ -41,6 +41,18 @@
 #define RVO_OUTPUT_TIME_AND_POSITIONS 1
 #endif
 
+#ifndef RVO_BENCHMARK
+#define RVO_BENCHMARK 0
+#endif
+
+#ifndef RVO_BENCHMARK_SCALE
+#define RVO_BENCHMARK_SCALE 1
+#endif
+
+#ifndef RVO_BENCHMARK_STEPS
+#define RVO_BENCHMARK_STEPS 2000
+#endif
+
 #ifndef RVO_SEED_RANDOM_NUMBER_GENERATOR
 #define RVO_SEED_RANDOM_NUMBER_GENERATOR 1
 #endif
@@ -64,6 +76,10 @@
 
 #include <RVO.h>
 
+#if RVO_BENCHMARK
+#include "Benchmark.h"
+#endif
+
 #ifndef M_PI
 const float M_PI = 3.14159265358979323846f;
 #endif
@@ -81,6 +97,9 @@ std::vector<RoadmapVertex> roadmap;
 /* Store the goals of the agents. */
 std::vector<int> goals;
 
+/* Cache the visibility of the roadmap vertices from the agents. */
+RVO::VisibilityCache *visibilityCache = NULL;
+
 void setupScenario(RVO::RVOSimulator *sim)
 {
 #if RVO_SEED_RANDOM_NUMBER_GENERATOR
@@ -178,8 +197,8 @@ void setupScenario(RVO::RVOSimulator *sim)
 	 * Add agents, specifying their start position, and store goals on the
 	 * opposite side of the environment (roadmap vertices).
 	 */
-	for (size_t i = 0; i < 5; ++i) {
-		for (size_t j = 0; j < 5; ++j) {
+	for (size_t i = 0; i < 5 * RVO_BENCHMARK_SCALE; ++i) {
+		for (size_t j = 0; j < 5 * RVO_BENCHMARK_SCALE; ++j) {
 			sim->addAgent(RVO::Vector2(55.0f + i * 10.0f,  55.0f + j * 10.0f));
 			goals.push_back(0);
 
@@ -213,12 +232,21 @@ void updateVisualization(RVO::RVOSimulator *sim)
 void buildRoadmap(RVO::RVOSimulator *sim)
 {
 	/* Connect the roadmap vertices by edges if mutually visible. */
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
+	std::vector<RVO::Vector2> points1, points2;
+	std::vector<bool> visible;
+
+	for (size_t i = 0; i < roadmap.size(); ++i) {
+		for (size_t j = 0; j < roadmap.size(); ++j) {
+			points1.push_back(roadmap[i].position);
+			points2.push_back(roadmap[j].position);
+		}
+	}
+
+	sim->queryVisibility(points1, points2, visible, sim->getAgentRadius(0));
+
 	for (int i = 0; i < static_cast<int>(roadmap.size()); ++i) {
 		for (int j = 0; j < static_cast<int>(roadmap.size()); ++j) {
-			if (sim->queryVisibility(roadmap[i].position, roadmap[j].position, sim->getAgentRadius(0))) {
+			if (visible[i * roadmap.size() + j]) {
 				roadmap[i].neighbors.push_back(j);
 			}
 		}
@@ -267,10 +295,27 @@ void buildRoadmap(RVO::RVOSimulator *sim)
 			}
 		}
 	}
+
+	/* Cache the visibility of the vertices per cell of agent radius size. */
+	std::vector<RVO::Vector2> vertices;
+
+	for (size_t i = 0; i < roadmap.size(); ++i) {
+		vertices.push_back(roadmap[i].position);
+	}
+
+	visibilityCache = new RVO::VisibilityCache(sim, vertices, sim->getAgentRadius(0), sim->getAgentRadius(0));
 }
 
 void setPreferredVelocities(RVO::RVOSimulator *sim)
 {
+	std::vector<RVO::Vector2> positions(sim->getNumAgents());
+
+	for (size_t i = 0; i < sim->getNumAgents(); ++i) {
+		positions[i] = sim->getAgentPosition(i);
+	}
+
+	visibilityCache->prepare(positions);
+
 	/*
 	 * Set the preferred velocity to be a vector of unit magnitude (speed) in the
 	 * direction of the visible roadmap vertex that is on the shortest path to the
@@ -285,7 +330,7 @@ void setPreferredVelocities(RVO::RVOSimulator *sim)
 
 		for (int j = 0; j < static_cast<int>(roadmap.size()); ++j) {
 			if (RVO::abs(roadmap[j].position - sim->getAgentPosition(i)) + roadmap[j].distToGoal[goals[i]] < minDist &&
-				sim->queryVisibility(sim->getAgentPosition(i), roadmap[j].position, sim->getAgentRadius(i))) {
+				visibilityCache->queryVisibility(sim->getAgentPosition(i), j)) {
 
 				minDist = RVO::abs(roadmap[j].position - sim->getAgentPosition(i)) + roadmap[j].distToGoal[goals[i]];
 				minVertex = j;
@@ -334,8 +379,16 @@ bool reachedGoal(RVO::RVOSimulator *sim)
 	return true;
 }
 
+#if RVO_BENCHMARK
+int main(int argc, char *argv[])
+#else
 int main()
+#endif
 {
+#if RVO_BENCHMARK
+	Benchmark benchmark("Roadmap");
+#endif
+
 	/* Create a new simulator instance. */
 	RVO::RVOSimulator *sim = new RVO::RVOSimulator();
 
@@ -345,16 +398,35 @@ int main()
 	/* Build the roadmap. */
 	buildRoadmap(sim);
 
+#if RVO_BENCHMARK
+	benchmark.endSetup();
+#endif
+
 	/* Perform (and manipulate) the simulation. */
 	do {
 #if RVO_OUTPUT_TIME_AND_POSITIONS
 		updateVisualization(sim);
 #endif
 		setPreferredVelocities(sim);
+#if RVO_BENCHMARK
+		benchmark.beginStep();
+#endif
 		sim->doStep();
+#if RVO_BENCHMARK
+		benchmark.endStep();
+#endif
+	}
+#if RVO_BENCHMARK
+	while (!reachedGoal(sim) && benchmark.getNumSteps() < RVO_BENCHMARK_STEPS);
+
+	if (!benchmark.write(sim, argc > 1 ? argv[1] : NULL)) {
+		return 1;
 	}
+#else
 	while (!reachedGoal(sim));
+#endif
 
+	delete visibilityCache;
 	delete sim;
 
 	return 0;
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+#
+# compare_benchmarks.py
+# RVO2 Library
+#
+# Compares the JSON results of the benchmark builds of the examples against a
+# stored baseline and fails when a benchmark got slower than the tolerance
+# allows. With --update, the results replace the baseline instead.
+#
+# Usage: compare_benchmarks.py [--tolerance T] [--metric NAME] [--update]
+#                              BASELINE RESULT...
+
+import argparse
+import json
+import sys
+
+
+def load_results(paths):
+    results = {}
+    for path in paths:
+        with open(path) as file:
+            result = json.load(file)
+        results[result["benchmark"]] = result
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare benchmark results against a baseline.")
+    parser.add_argument("baseline", help="baseline JSON file")
+    parser.add_argument("results", nargs="+", help="benchmark JSON results")
+    parser.add_argument("--tolerance", type=float, default=0.25,
+                        help="allowed slowdown as a fraction (default 0.25)")
+    parser.add_argument("--metric", default="stepMedianSeconds",
+                        help="result field to compare "
+                             "(default stepMedianSeconds)")
+    parser.add_argument("--update", action="store_true",
+                        help="write the results as the new baseline")
+    args = parser.parse_args()
+
+    results = load_results(args.results)
+
+    if args.update:
+        with open(args.baseline, "w") as file:
+            json.dump(results, file, indent=2, sort_keys=True)
+            file.write("\n")
+        print("Wrote %d benchmarks to %s" % (len(results), args.baseline))
+        return 0
+
+    with open(args.baseline) as file:
+        baseline = json.load(file)
+
+    failed = False
+    print("%-12s %14s %14s %8s" % ("Benchmark", "baseline", "result",
+                                   "ratio"))
+    for name in sorted(results):
+        result = results[name]
+        if name not in baseline:
+            print("%-12s not in the baseline" % name)
+            failed = True
+            continue
+        reference = baseline[name]
+
+        # Timings of different workloads are not comparable.
+        workload = ("agents", "obstacleVertices", "steps")
+        if any(result[key] != reference[key] for key in workload):
+            print("%-12s workload differs from the baseline (%s), "
+                  "update the baseline" % (
+                      name, ", ".join("%s %s vs %s" % (
+                          key, result[key], reference[key])
+                          for key in workload)))
+            failed = True
+            continue
+
+        ratio = result[args.metric] / max(reference[args.metric], 1e-12)
+        if ratio > 1.0 + args.tolerance:
+            verdict = "REGRESSION"
+            failed = True
+        elif ratio < 1.0 - args.tolerance:
+            verdict = "faster, consider --update"
+        else:
+            verdict = "ok"
+        print("%-12s %14.9f %14.9f %8.3f %s" % (
+            name, reference[args.metric], result[args.metric], ratio,
+            verdict))
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -32,32 +32,50 @@
 
 #include "Agent.h"
 
+#include "AgentProfile.h"
+#include "ConstraintCapture.h"
 #include "KdTree.h"
 #include "Obstacle.h"
 
+#include <algorithm>
+
 namespace RVO {
-	Agent::Agent(RVOSimulator *sim) : maxNeighbors_(0), maxSpeed_(0.0f), neighborDist_(0.0f), radius_(0.0f), sim_(sim), timeHorizon_(0.0f), timeHorizonObst_(0.0f), id_(0) { }
+	Agent::Agent(RVOSimulator *sim) : profile_(NULL), sim_(sim), id_(0), slot_(0) { }
 
 	void Agent::computeNeighbors()
 	{
 		obstacleNeighbors_.clear();
-		float rangeSq = sqr(timeHorizonObst_ * maxSpeed_ + radius_);
+		float rangeSq = sqr(profile_->timeHorizonObst_ * profile_->maxSpeed_ + profile_->radius_);
 		sim_->kdTree_->computeObstacleNeighbors(this, rangeSq);
 
 		agentNeighbors_.clear();
 
-		if (maxNeighbors_ > 0) {
-			rangeSq = sqr(neighborDist_);
+		if (profile_->maxNeighbors_ > 0) {
+			rangeSq = sqr(profile_->neighborDist_);
 			sim_->kdTree_->computeAgentNeighbors(this, rangeSq);
 		}
 	}
 
+	void Agent::computeNeighbors(const std::vector<std::pair<float, size_t> > &leaves)
+	{
+		obstacleNeighbors_.clear();
+		float rangeSq = sqr(profile_->timeHorizonObst_ * profile_->maxSpeed_ + profile_->radius_);
+		sim_->kdTree_->computeObstacleNeighbors(this, rangeSq);
+
+		agentNeighbors_.clear();
+
+		if (profile_->maxNeighbors_ > 0) {
+			rangeSq = sqr(profile_->neighborDist_);
+			sim_->kdTree_->computeAgentNeighbors(this, rangeSq, leaves);
+		}
+	}
+
 	/* Search for the best new velocity. */
-	void Agent::computeNewVelocity()
+	void Agent::computeNewVelocity(SolverStats &stats, std::vector<Line> &projLines)
 	{
 		orcaLines_.clear();
 
-		const float invTimeHorizonObst = 1.0f / timeHorizonObst_;
+		const float invTimeHorizonObst = 1.0f / profile_->timeHorizonObst_;
 
 		/* Create obstacle ORCA lines. */
 		for (size_t i = 0; i < obstacleNeighbors_.size(); ++i) {
@@ -75,13 +93,14 @@ namespace RVO {
 			bool alreadyCovered = false;
 
 			for (size_t j = 0; j < orcaLines_.size(); ++j) {
-				if (det(invTimeHorizonObst * relativePosition1 - orcaLines_[j].point, orcaLines_[j].direction) - invTimeHorizonObst * radius_ >= -RVO_EPSILON && det(invTimeHorizonObst * relativePosition2 - orcaLines_[j].point, orcaLines_[j].direction) - invTimeHorizonObst * radius_ >=  -RVO_EPSILON) {
+				if (det(invTimeHorizonObst * relativePosition1 - orcaLines_[j].point, orcaLines_[j].direction) - invTimeHorizonObst * profile_->radius_ >= -RVO_EPSILON && det(invTimeHorizonObst * relativePosition2 - orcaLines_[j].point, orcaLines_[j].direction) - invTimeHorizonObst * profile_->radius_ >=  -RVO_EPSILON) {
 					alreadyCovered = true;
 					break;
 				}
 			}
 
 			if (alreadyCovered) {
+				++stats.coveredObstacles;
 				continue;
 			}
 
@@ -90,7 +109,7 @@ namespace RVO {
 			const float distSq1 = absSq(relativePosition1);
 			const float distSq2 = absSq(relativePosition2);
 
-			const float radiusSq = sqr(radius_);
+			const float radiusSq = sqr(profile_->radius_);
 
 			const Vector2 obstacleVector = obstacle2->point_ - obstacle1->point_;
 			const float s = (-relativePosition1 * obstacleVector) / absSq(obstacleVector);
@@ -148,8 +167,8 @@ namespace RVO {
 				obstacle2 = obstacle1;
 
 				const float leg1 = std::sqrt(distSq1 - radiusSq);
-				leftLegDirection = Vector2(relativePosition1.x() * leg1 - relativePosition1.y() * radius_, relativePosition1.x() * radius_ + relativePosition1.y() * leg1) / distSq1;
-				rightLegDirection = Vector2(relativePosition1.x() * leg1 + relativePosition1.y() * radius_, -relativePosition1.x() * radius_ + relativePosition1.y() * leg1) / distSq1;
+				leftLegDirection = Vector2(relativePosition1.x() * leg1 - relativePosition1.y() * profile_->radius_, relativePosition1.x() * profile_->radius_ + relativePosition1.y() * leg1) / distSq1;
+				rightLegDirection = Vector2(relativePosition1.x() * leg1 + relativePosition1.y() * profile_->radius_, -relativePosition1.x() * profile_->radius_ + relativePosition1.y() * leg1) / distSq1;
 			}
 			else if (s > 1.0f && distSqLine <= radiusSq) {
 				/*
@@ -164,14 +183,14 @@ namespace RVO {
 				obstacle1 = obstacle2;
 
 				const float leg2 = std::sqrt(distSq2 - radiusSq);
-				leftLegDirection = Vector2(relativePosition2.x() * leg2 - relativePosition2.y() * radius_, relativePosition2.x() * radius_ + relativePosition2.y() * leg2) / distSq2;
-				rightLegDirection = Vector2(relativePosition2.x() * leg2 + relativePosition2.y() * radius_, -relativePosition2.x() * radius_ + relativePosition2.y() * leg2) / distSq2;
+				leftLegDirection = Vector2(relativePosition2.x() * leg2 - relativePosition2.y() * profile_->radius_, relativePosition2.x() * profile_->radius_ + relativePosition2.y() * leg2) / distSq2;
+				rightLegDirection = Vector2(relativePosition2.x() * leg2 + relativePosition2.y() * profile_->radius_, -relativePosition2.x() * profile_->radius_ + relativePosition2.y() * leg2) / distSq2;
 			}
 			else {
 				/* Usual situation. */
 				if (obstacle1->isConvex_) {
 					const float leg1 = std::sqrt(distSq1 - radiusSq);
-					leftLegDirection = Vector2(relativePosition1.x() * leg1 - relativePosition1.y() * radius_, relativePosition1.x() * radius_ + relativePosition1.y() * leg1) / distSq1;
+					leftLegDirection = Vector2(relativePosition1.x() * leg1 - relativePosition1.y() * profile_->radius_, relativePosition1.x() * profile_->radius_ + relativePosition1.y() * leg1) / distSq1;
 				}
 				else {
 					/* Left vertex non-convex; left leg extends cut-off line. */
@@ -180,7 +199,7 @@ namespace RVO {
 
 				if (obstacle2->isConvex_) {
 					const float leg2 = std::sqrt(distSq2 - radiusSq);
-					rightLegDirection = Vector2(relativePosition2.x() * leg2 + relativePosition2.y() * radius_, -relativePosition2.x() * radius_ + relativePosition2.y() * leg2) / distSq2;
+					rightLegDirection = Vector2(relativePosition2.x() * leg2 + relativePosition2.y() * profile_->radius_, -relativePosition2.x() * profile_->radius_ + relativePosition2.y() * leg2) / distSq2;
 				}
 				else {
 					/* Right vertex non-convex; right leg extends cut-off line. */
@@ -228,7 +247,7 @@ namespace RVO {
 				const Vector2 unitW = normalize(velocity_ - leftCutoff);
 
 				line.direction = Vector2(unitW.y(), -unitW.x());
-				line.point = leftCutoff + radius_ * invTimeHorizonObst * unitW;
+				line.point = leftCutoff + profile_->radius_ * invTimeHorizonObst * unitW;
 				orcaLines_.push_back(line);
 				continue;
 			}
@@ -237,7 +256,7 @@ namespace RVO {
 				const Vector2 unitW = normalize(velocity_ - rightCutoff);
 
 				line.direction = Vector2(unitW.y(), -unitW.x());
-				line.point = rightCutoff + radius_ * invTimeHorizonObst * unitW;
+				line.point = rightCutoff + profile_->radius_ * invTimeHorizonObst * unitW;
 				orcaLines_.push_back(line);
 				continue;
 			}
@@ -253,7 +272,7 @@ namespace RVO {
 			if (distSqCutoff <= distSqLeft && distSqCutoff <= distSqRight) {
 				/* Project on cut-off line. */
 				line.direction = -obstacle1->unitDir_;
-				line.point = leftCutoff + radius_ * invTimeHorizonObst * Vector2(-line.direction.y(), line.direction.x());
+				line.point = leftCutoff + profile_->radius_ * invTimeHorizonObst * Vector2(-line.direction.y(), line.direction.x());
 				orcaLines_.push_back(line);
 				continue;
 			}
@@ -264,7 +283,7 @@ namespace RVO {
 				}
 
 				line.direction = leftLegDirection;
-				line.point = leftCutoff + radius_ * invTimeHorizonObst * Vector2(-line.direction.y(), line.direction.x());
+				line.point = leftCutoff + profile_->radius_ * invTimeHorizonObst * Vector2(-line.direction.y(), line.direction.x());
 				orcaLines_.push_back(line);
 				continue;
 			}
@@ -275,7 +294,7 @@ namespace RVO {
 				}
 
 				line.direction = -rightLegDirection;
-				line.point = rightCutoff + radius_ * invTimeHorizonObst * Vector2(-line.direction.y(), line.direction.x());
+				line.point = rightCutoff + profile_->radius_ * invTimeHorizonObst * Vector2(-line.direction.y(), line.direction.x());
 				orcaLines_.push_back(line);
 				continue;
 			}
@@ -283,7 +302,34 @@ namespace RVO {
 
 		const size_t numObstLines = orcaLines_.size();
 
-		const float invTimeHorizon = 1.0f / timeHorizon_;
+		bool colliding = false;
+
+		const float invTimeHorizon = 1.0f / profile_->timeHorizon_;
+
+		size_t numTight = 0;
+
+		if (sim_->linearProgramWarmStart_) {
+			/* The neighbors whose lines were tight in the previous step go first, the others keep their order of distance. */
+			for (size_t i = 0; i < agentNeighbors_.size(); ++i) {
+				if (std::find(tightNeighbors_.begin(), tightNeighbors_.end(), agentNeighbors_[i].second->slot_) != tightNeighbors_.end()) {
+					std::rotate(agentNeighbors_.begin() + numTight, agentNeighbors_.begin() + i, agentNeighbors_.begin() + i + 1);
+					++numTight;
+				}
+			}
+		}
+
+		if (sim_->linearProgramRandomOrder_) {
+			/* Shuffles the neighbors after the tight ones with a generator seeded by the slot and step, so that runs are reproducible. */
+			unsigned int seed = static_cast<unsigned int>(slot_) * 2654435761u ^ static_cast<unsigned int>(sim_->numSteps_) * 2246822519u;
+			seed ^= seed >> 15;
+			seed *= 2246822519u;
+			seed ^= seed >> 13;
+
+			for (size_t i = agentNeighbors_.size(); i > numTight + 1; --i) {
+				seed = seed * 1664525u + 1013904223u;
+				std::swap(agentNeighbors_[i - 1], agentNeighbors_[numTight + (seed >> 8) % (i - numTight)]);
+			}
+		}
 
 		/* Create agent ORCA lines. */
 		for (size_t i = 0; i < agentNeighbors_.size(); ++i) {
@@ -292,7 +338,7 @@ namespace RVO {
 			const Vector2 relativePosition = other->position_ - position_;
 			const Vector2 relativeVelocity = velocity_ - other->velocity_;
 			const float distSq = absSq(relativePosition);
-			const float combinedRadius = radius_ + other->radius_;
+			const float combinedRadius = profile_->radius_ + other->profile_->radius_;
 			const float combinedRadiusSq = sqr(combinedRadius);
 
 			Line line;
@@ -334,6 +380,8 @@ namespace RVO {
 			}
 			else {
 				/* Collision. Project on cut-off circle of time timeStep. */
+				colliding = true;
+
 				const float invTimeStep = 1.0f / sim_->timeStep_;
 
 				/* Vector from cutoff center to relative velocity. */
@@ -350,10 +398,32 @@ namespace RVO {
 			orcaLines_.push_back(line);
 		}
 
-		size_t lineFail = linearProgram2(orcaLines_, maxSpeed_, prefVelocity_, false, newVelocity_);
+		++stats.agents;
+		stats.obstacleLines += numObstLines;
+		stats.agentLines += orcaLines_.size() - numObstLines;
+		stats.collidingAgents += colliding ? 1 : 0;
+
+		size_t lineFail = linearProgram2(orcaLines_, profile_->maxSpeed_, prefVelocity_, false, newVelocity_, stats);
 
 		if (lineFail < orcaLines_.size()) {
-			linearProgram3(orcaLines_, numObstLines, lineFail, maxSpeed_, newVelocity_);
+			++stats.linearProgram3Calls;
+			linearProgram3(orcaLines_, numObstLines, lineFail, profile_->maxSpeed_, newVelocity_, projLines, stats);
+		}
+
+		if (sim_->linearProgramWarmStart_) {
+			tightNeighbors_.clear();
+
+			for (size_t i = 0; i < agentNeighbors_.size(); ++i) {
+				const Line &line = orcaLines_[numObstLines + i];
+
+				if (det(line.direction, line.point - newVelocity_) > -RVO_EPSILON) {
+					tightNeighbors_.push_back(agentNeighbors_[i].second->slot_);
+				}
+			}
+		}
+
+		if (ConstraintCapture::isCaptured(sim_, id_)) {
+			ConstraintCapture::record(orcaLines_, numObstLines, profile_->maxSpeed_, prefVelocity_, newVelocity_);
 		}
 	}
 
@@ -363,7 +433,7 @@ namespace RVO {
 			const float distSq = absSq(position_ - agent->position_);
 
 			if (distSq < rangeSq) {
-				if (agentNeighbors_.size() < maxNeighbors_) {
+				if (agentNeighbors_.size() < profile_->maxNeighbors_) {
 					agentNeighbors_.push_back(std::make_pair(distSq, agent));
 				}
 
@@ -376,7 +446,7 @@ namespace RVO {
 
 				agentNeighbors_[i] = std::make_pair(distSq, agent);
 
-				if (agentNeighbors_.size() == maxNeighbors_) {
+				if (agentNeighbors_.size() == profile_->maxNeighbors_) {
 					rangeSq = agentNeighbors_.back().first;
 				}
 			}
@@ -403,6 +473,45 @@ namespace RVO {
 		}
 	}
 
+	bool Agent::loadState(const std::vector<char> &state, size_t &offset, const std::vector<AgentProfile *> &profiles)
+	{
+		size_t profileNo = 0;
+		size_t numTightNeighbors = 0;
+
+		if (!(readState(state, offset, position_) &&
+			  readState(state, offset, prefVelocity_) &&
+			  readState(state, offset, profileNo) && profileNo < profiles.size() &&
+			  readState(state, offset, velocity_) &&
+			  readState(state, offset, numTightNeighbors) && numTightNeighbors <= state.size())) {
+			return false;
+		}
+
+		tightNeighbors_.resize(numTightNeighbors);
+
+		for (size_t i = 0; i < numTightNeighbors; ++i) {
+			if (!readState(state, offset, tightNeighbors_[i])) {
+				return false;
+			}
+		}
+
+		profile_ = profiles[profileNo];
+
+		return true;
+	}
+
+	void Agent::saveState(std::vector<char> &state) const
+	{
+		writeState(state, position_);
+		writeState(state, prefVelocity_);
+		writeState(state, profile_->id_);
+		writeState(state, velocity_);
+		writeState(state, tightNeighbors_.size());
+
+		for (size_t i = 0; i < tightNeighbors_.size(); ++i) {
+			writeState(state, tightNeighbors_[i]);
+		}
+	}
+
 	void Agent::update()
 	{
 		velocity_ = newVelocity_;
@@ -482,7 +591,7 @@ namespace RVO {
 		return true;
 	}
 
-	size_t linearProgram2(const std::vector<Line> &lines, float radius, const Vector2 &optVelocity, bool directionOpt, Vector2 &result)
+	size_t linearProgram2(const std::vector<Line> &lines, float radius, const Vector2 &optVelocity, bool directionOpt, Vector2 &result, SolverStats &stats)
 	{
 		if (directionOpt) {
 			/*
@@ -505,6 +614,8 @@ namespace RVO {
 				/* Result does not satisfy constraint i. Compute new optimal result. */
 				const Vector2 tempResult = result;
 
+				++stats.linearProgram1Calls;
+
 				if (!linearProgram1(lines, i, radius, optVelocity, directionOpt, result)) {
 					result = tempResult;
 					return i;
@@ -515,14 +626,14 @@ namespace RVO {
 		return lines.size();
 	}
 
-	void linearProgram3(const std::vector<Line> &lines, size_t numObstLines, size_t beginLine, float radius, Vector2 &result)
+	void linearProgram3(const std::vector<Line> &lines, size_t numObstLines, size_t beginLine, float radius, Vector2 &result, std::vector<Line> &projLines, SolverStats &stats)
 	{
 		float distance = 0.0f;
 
 		for (size_t i = beginLine; i < lines.size(); ++i) {
 			if (det(lines[i].direction, lines[i].point - result) > distance) {
 				/* Result does not satisfy constraint of line i. */
-				std::vector<Line> projLines(lines.begin(), lines.begin() + static_cast<ptrdiff_t>(numObstLines));
+				projLines.assign(lines.begin(), lines.begin() + static_cast<ptrdiff_t>(numObstLines));
 
 				for (size_t j = numObstLines; j < i; ++j) {
 					Line line;
@@ -550,7 +661,7 @@ namespace RVO {
 
 				const Vector2 tempResult = result;
 
-				if (linearProgram2(projLines, radius, Vector2(-lines[i].direction.y(), lines[i].direction.x()), true, result) < projLines.size()) {
+				if (linearProgram2(projLines, radius, Vector2(-lines[i].direction.y(), lines[i].direction.x()), true, result, stats) < projLines.size()) {
 					/* This should in principle not happen.  The result is by definition
 					 * already in the feasible region of this linear program. If it fails,
 					 * it is due to small floating point error, and the current result is
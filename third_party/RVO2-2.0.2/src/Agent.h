@@ -58,10 +58,25 @@ namespace RVO {
 		 */
 		void computeNeighbors();
 
+		/**
+		 * \brief      Computes the neighbors of this agent, searching only the
+		 *             specified candidate leaves of the agent <i>k</i>d-tree for
+		 *             agent neighbors.
+		 * \param      leaves          The candidate leaves, as computed by
+		 *                             KdTree::computeLeafCandidates for the leaf
+		 *                             containing this agent.
+		 */
+		void computeNeighbors(const std::vector<std::pair<float, size_t> > &
+							  leaves);
+
 		/**
 		 * \brief      Computes the new velocity of this agent.
+		 * \param      stats           The solver counters of the calling
+		 *                             thread, which are incremented.
+		 * \param      projLines       The scratch lines of the calling thread
+		 *                             for linearProgram3.
 		 */
-		void computeNewVelocity();
+		void computeNewVelocity(SolverStats &stats, std::vector<Line> &projLines);
 
 		/**
 		 * \brief      Inserts an agent neighbor into the set of neighbors of
@@ -80,6 +95,26 @@ namespace RVO {
 		 */
 		void insertObstacleNeighbor(const Obstacle *obstacle, float rangeSq);
 
+		/**
+		 * \brief      Restores the properties and state of this agent from a
+		 *             serialized simulator state.
+		 * \param      state           The serialized state.
+		 * \param      offset          The offset of this agent in the state,
+		 *                             which is advanced past this agent.
+		 * \param      profiles        The agent profiles of the restored
+		 *                             simulation.
+		 * \return     True if the state holds a complete agent.
+		 */
+		bool loadState(const std::vector<char> &state, size_t &offset,
+					   const std::vector<AgentProfile *> &profiles);
+
+		/**
+		 * \brief      Appends the properties and state of this agent to a
+		 *             serialized simulator state.
+		 * \param      state           The serialized state.
+		 */
+		void saveState(std::vector<char> &state) const;
+
 		/**
 		 * \brief      Updates the two-dimensional position and two-dimensional
 		 *             velocity of this agent.
@@ -87,21 +122,18 @@ namespace RVO {
 		void update();
 
 		std::vector<std::pair<float, const Agent *> > agentNeighbors_;
-		size_t maxNeighbors_;
-		float maxSpeed_;
-		float neighborDist_;
 		Vector2 newVelocity_;
 		std::vector<std::pair<float, const Obstacle *> > obstacleNeighbors_;
 		std::vector<Line> orcaLines_;
 		Vector2 position_;
 		Vector2 prefVelocity_;
-		float radius_;
+		AgentProfile *profile_;
 		RVOSimulator *sim_;
-		float timeHorizon_;
-		float timeHorizonObst_;
+		std::vector<size_t> tightNeighbors_;
 		Vector2 velocity_;
 
 		size_t id_;
+		size_t slot_;
 
 		friend class KdTree;
 		friend class RVOSimulator;
@@ -133,11 +165,12 @@ namespace RVO {
 	 * \param      optVelocity   The optimization velocity.
 	 * \param      directionOpt  True if the direction should be optimized.
 	 * \param      result        A reference to the result of the linear program.
+	 * \param      stats         The solver counters to increment.
 	 * \return     The number of the line it fails on, and the number of lines if successful.
 	 */
 	size_t linearProgram2(const std::vector<Line> &lines, float radius,
 						  const Vector2 &optVelocity, bool directionOpt,
-						  Vector2 &result);
+						  Vector2 &result, SolverStats &stats);
 
 	/**
 	 * \relates    Agent
@@ -148,9 +181,14 @@ namespace RVO {
 	 * \param      beginLine     The line on which the 2-d linear program failed.
 	 * \param      radius        The radius of the circular constraint.
 	 * \param      result        A reference to the result of the linear program.
+	 * \param      projLines     Scratch lines for the projected constraints,
+	 *                           reused so that no memory is allocated once
+	 *                           their capacity suffices.
+	 * \param      stats         The solver counters to increment.
 	 */
 	void linearProgram3(const std::vector<Line> &lines, size_t numObstLines, size_t beginLine,
-						float radius, Vector2 &result);
+						float radius, Vector2 &result, std::vector<Line> &projLines,
+						SolverStats &stats);
 }
 
 #endif /* RVO_AGENT_H_ */
@@ -0,0 +1,59 @@
+/*
+ * AgentProfile.h
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RVO_AGENT_PROFILE_H_
+#define RVO_AGENT_PROFILE_H_
+
+/**
+ * \file       AgentProfile.h
+ * \brief      Contains the AgentProfile class.
+ */
+
+#include "Definitions.h"
+
+namespace RVO {
+	/**
+	 * \brief      Defines the parameters shared by a group of agents in the
+	 *             simulation.
+	 */
+	class AgentProfile {
+	private:
+		/**
+		 * \brief      Constructs an agent profile instance.
+		 */
+		AgentProfile();
+
+		size_t maxNeighbors_;
+		float maxSpeed_;
+		float neighborDist_;
+		float radius_;
+		float timeHorizon_;
+		float timeHorizonObst_;
+
+		bool isOverride_;
+		size_t numAgents_;
+		size_t id_;
+
+		friend class Agent;
+		friend class KdTree;
+		friend class RVOSimulator;
+	};
+}
+
+#endif /* RVO_AGENT_PROFILE_H_ */
@@ -0,0 +1,190 @@
+/*
+ * ConstraintCapture.cpp
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+
+
+#include "ConstraintCapture.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+
+namespace RVO {
+	namespace {
+		const unsigned int CAPTURE_MAGIC = 0x434f5652;
+		const unsigned int CAPTURE_VERSION = 1;
+
+		std::mutex captureMutex;
+		std::vector<char> captureBuffer;
+		bool captureEnabled = false;
+		size_t captureMaxRecords = 0;
+		size_t captureNumRecords = 0;
+		size_t captureStepInterval = 1;
+
+		template <typename T>
+		void writeRecord(std::vector<char> &buffer, const T &value)
+		{
+			const char *const bytes = reinterpret_cast<const char *>(&value);
+			buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+		}
+
+		template <typename T>
+		bool readRecord(const std::vector<char> &buffer, size_t &offset, T &value)
+		{
+			if (buffer.size() - offset < sizeof(T)) {
+				return false;
+			}
+
+			std::memcpy(&value, &buffer[offset], sizeof(T));
+			offset += sizeof(T);
+
+			return true;
+		}
+	}
+
+	size_t ConstraintCapture::agentInterval_ = 1;
+
+	bool ConstraintCapture::beginStep(size_t &step)
+	{
+		/* The step counter of the simulator restarts while the capture is disabled, and no shared state is written. */
+		if (!captureEnabled) {
+			step = 0;
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(captureMutex);
+
+		return step++ % captureStepInterval == 0 && captureNumRecords < captureMaxRecords;
+	}
+
+	void ConstraintCapture::disable()
+	{
+		captureEnabled = false;
+	}
+
+	void ConstraintCapture::enable(size_t agentInterval, size_t stepInterval, size_t maxRecords)
+	{
+		reset();
+
+		agentInterval_ = agentInterval > 0 ? agentInterval : 1;
+		captureStepInterval = stepInterval > 0 ? stepInterval : 1;
+		captureMaxRecords = maxRecords;
+		captureEnabled = true;
+	}
+
+	size_t ConstraintCapture::getNumRecords()
+	{
+		std::lock_guard<std::mutex> lock(captureMutex);
+
+		return captureNumRecords;
+	}
+
+	bool ConstraintCapture::isEnabled()
+	{
+		return captureEnabled;
+	}
+
+	bool ConstraintCapture::read(const std::string &fileName, std::vector<ConstraintRecord> &records)
+	{
+		std::ifstream file(fileName.c_str(), std::ios::binary);
+		std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		size_t offset = 0;
+		unsigned int magic, version;
+
+		if (!file || !readRecord(buffer, offset, magic) || magic != CAPTURE_MAGIC || !readRecord(buffer, offset, version) || version != CAPTURE_VERSION) {
+			return false;
+		}
+
+		std::vector<ConstraintRecord> read;
+
+		while (offset < buffer.size()) {
+			ConstraintRecord record;
+			unsigned int numLines, numObstLines;
+
+			if (!readRecord(buffer, offset, numLines) || !readRecord(buffer, offset, numObstLines) || numObstLines > numLines ||
+			    !readRecord(buffer, offset, record.maxSpeed) || !readRecord(buffer, offset, record.prefVelocity) || !readRecord(buffer, offset, record.result) ||
+			    (buffer.size() - offset) / sizeof(Line) < numLines) {
+				return false;
+			}
+
+			record.numObstLines = numObstLines;
+			record.lines.resize(numLines);
+
+			for (size_t i = 0; i < numLines; ++i) {
+				readRecord(buffer, offset, record.lines[i].point);
+				readRecord(buffer, offset, record.lines[i].direction);
+			}
+
+			read.push_back(record);
+		}
+
+		records.swap(read);
+
+		return true;
+	}
+
+	void ConstraintCapture::record(const std::vector<Line> &lines, size_t numObstLines, float maxSpeed, const Vector2 &prefVelocity, const Vector2 &result)
+	{
+		std::lock_guard<std::mutex> lock(captureMutex);
+
+		if (captureNumRecords >= captureMaxRecords) {
+			return;
+		}
+
+		writeRecord(captureBuffer, static_cast<unsigned int>(lines.size()));
+		writeRecord(captureBuffer, static_cast<unsigned int>(numObstLines));
+		writeRecord(captureBuffer, maxSpeed);
+		writeRecord(captureBuffer, prefVelocity);
+		writeRecord(captureBuffer, result);
+
+		for (size_t i = 0; i < lines.size(); ++i) {
+			writeRecord(captureBuffer, lines[i].point);
+			writeRecord(captureBuffer, lines[i].direction);
+		}
+
+		++captureNumRecords;
+	}
+
+	void ConstraintCapture::reset()
+	{
+		std::lock_guard<std::mutex> lock(captureMutex);
+
+		captureBuffer.clear();
+		captureNumRecords = 0;
+	}
+
+	bool ConstraintCapture::write(const std::string &fileName)
+	{
+		std::lock_guard<std::mutex> lock(captureMutex);
+
+		std::ofstream file(fileName.c_str(), std::ios::binary);
+		file.write(reinterpret_cast<const char *>(&CAPTURE_MAGIC), sizeof(CAPTURE_MAGIC));
+		file.write(reinterpret_cast<const char *>(&CAPTURE_VERSION), sizeof(CAPTURE_VERSION));
+
+		if (!captureBuffer.empty()) {
+			file.write(&captureBuffer[0], captureBuffer.size());
+		}
+
+		return static_cast<bool>(file.flush());
+	}
+}
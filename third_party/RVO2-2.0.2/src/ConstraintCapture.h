@@ -0,0 +1,158 @@
+/*
+ * ConstraintCapture.h
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+
+
+#ifndef RVO_CONSTRAINT_CAPTURE_H_
+#define RVO_CONSTRAINT_CAPTURE_H_
+
+/**
+ * \file       ConstraintCapture.h
+ * \brief      Contains the ConstraintCapture and ConstraintRecord classes.
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "RVOSimulator.h"
+
+namespace RVO {
+	/**
+	 * \brief      Defines the linear program of one agent in one step: the
+	 *             ORCA lines with the obstacle lines first, the maximum speed,
+	 *             the preferred velocity and the velocity the simulation
+	 *             computed from them.
+	 */
+	class ConstraintRecord {
+	public:
+		/**
+		 * \brief      The ORCA lines, starting with the obstacle lines.
+		 */
+		std::vector<Line> lines;
+
+		/**
+		 * \brief      The maximum speed, the radius of the circular
+		 *             constraint.
+		 */
+		float maxSpeed;
+
+		/**
+		 * \brief      The number of obstacle lines.
+		 */
+		size_t numObstLines;
+
+		/**
+		 * \brief      The preferred velocity, the optimization velocity.
+		 */
+		Vector2 prefVelocity;
+
+		/**
+		 * \brief      The new velocity computed by the simulation.
+		 */
+		Vector2 result;
+	};
+
+	/**
+	 * \brief      Captures the linear programs that agents solve for their new
+	 *             velocities into a corpus, so that linear program
+	 *             implementations can be compared and timed offline on the
+	 *             exact inputs of a simulation.
+	 *
+	 * The agents whose number is a multiple of the agent interval are
+	 * captured in the steps whose number since the capture was enabled is a
+	 * multiple of the step interval, until the maximum number of records is
+	 * reached. The steps are counted and sampled per simulator, so that
+	 * simulators stepping on different threads stay independent. Their
+	 * records go into the same corpus.
+	 */
+	class ConstraintCapture {
+	public:
+		/**
+		 * \brief      Stops capturing. The captured records are kept until
+		 *             the capture is enabled or reset.
+		 *
+		 * Must not be called while a simulation step runs.
+		 */
+		static void disable();
+
+		/**
+		 * \brief      Discards the captured records and starts capturing
+		 *             the following steps.
+		 * \param      agentInterval   The interval between captured agent
+		 *                             numbers.
+		 * \param      stepInterval    The interval between captured steps.
+		 * \param      maxRecords      The maximum number of records.
+		 *
+		 * Must not be called while a simulation step runs.
+		 */
+		static void enable(size_t agentInterval, size_t stepInterval, size_t maxRecords);
+
+		/**
+		 * \brief      Returns the number of captured records.
+		 * \return     The number of records.
+		 */
+		static size_t getNumRecords();
+
+		/**
+		 * \brief      Returns whether steps are captured.
+		 * \return     True if the capture is enabled.
+		 */
+		static bool isEnabled();
+
+		/**
+		 * \brief      Reads the records of a corpus file written by write.
+		 * \param      fileName        The name of the corpus file.
+		 * \param      records         The records, replaced by those of the
+		 *                             file.
+		 * \return     True if the file was read.
+		 */
+		static bool read(const std::string &fileName, std::vector<ConstraintRecord> &records);
+
+		/**
+		 * \brief      Discards the captured records.
+		 *
+		 * Must not be called while a simulation step runs.
+		 */
+		static void reset();
+
+		/**
+		 * \brief      Writes the captured records to a corpus file.
+		 * \param      fileName        The name of the corpus file.
+		 * \return     True if the file was written.
+		 */
+		static bool write(const std::string &fileName);
+
+	private:
+		static bool beginStep(size_t &step);
+
+		static bool isCaptured(const RVOSimulator *sim, size_t agentNo) { return sim->constraintCapturing_ && agentNo % agentInterval_ == 0; }
+
+		static void record(const std::vector<Line> &lines, size_t numObstLines, float maxSpeed, const Vector2 &prefVelocity, const Vector2 &result);
+
+		static size_t agentInterval_;
+
+		friend class Agent;
+		friend class RVOSimulator;
+	};
+}
+
+#endif /* RVO_CONSTRAINT_CAPTURE_H_ */
@@ -41,6 +41,7 @@
 #include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <cstring>
 #include <limits>
 #include <vector>
 
@@ -95,6 +96,28 @@ namespace RVO {
 		return det(a - c, b - a);
 	}
 
+	/**
+	 * \brief      Reads a value from a serialized simulator state.
+	 * \param      state           The serialized state.
+	 * \param      offset          The offset of the value in the state, which
+	 *                             is advanced past the value.
+	 * \param      value           The value that is read.
+	 * \return     True if the state holds enough bytes for the value.
+	 */
+	template <typename T>
+	inline bool readState(const std::vector<char> &state, size_t &offset,
+						  T &value)
+	{
+		if (offset > state.size() || state.size() - offset < sizeof(T)) {
+			return false;
+		}
+
+		std::memcpy(&value, &state[offset], sizeof(T));
+		offset += sizeof(T);
+
+		return true;
+	}
+
 	/**
 	 * \brief      Computes the square of a float.
 	 * \param      a               The float to be squared.
@@ -104,6 +127,18 @@ namespace RVO {
 	{
 		return a * a;
 	}
+
+	/**
+	 * \brief      Appends a value to a serialized simulator state.
+	 * \param      state           The serialized state.
+	 * \param      value           The value to be appended.
+	 */
+	template <typename T>
+	inline void writeState(std::vector<char> &state, const T &value)
+	{
+		const char *const bytes = reinterpret_cast<const char *>(&value);
+		state.insert(state.end(), bytes, bytes + sizeof(T));
+	}
 }
 
 #endif /* RVO_DEFINITIONS_H_ */
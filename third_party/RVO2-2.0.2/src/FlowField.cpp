@@ -0,0 +1,221 @@
+/*
+ * FlowField.cpp
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "FlowField.h"
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+#include "RVOSimulator.h"
+
+namespace RVO {
+	FlowField::FlowField(const RVOSimulator *sim, const Vector2 &goal, const Vector2 &minCorner, const Vector2 &maxCorner, float cellSize, float radius) : cellSize_(cellSize), goal_(goal), minCorner_(minCorner), numCellsX_(0), numCellsY_(0)
+	{
+		numCellsX_ = static_cast<size_t>(std::ceil((maxCorner.x() - minCorner.x()) / cellSize_));
+		numCellsY_ = static_cast<size_t>(std::ceil((maxCorner.y() - minCorner.y()) / cellSize_));
+
+		const size_t numCells = numCellsX_ * numCellsY_;
+		const float infinity = std::numeric_limits<float>::infinity();
+
+		remaining_.assign(numCells, infinity);
+		waypoints_.assign(numCells, goal_);
+
+		const size_t goalCell = getCell(goal_);
+
+		if (goalCell == numCells) {
+			/* Goal outside the field; every lookup heads straight for it. */
+			return;
+		}
+
+		std::vector<Vector2> centers(numCells);
+		std::vector<char> blocked(numCells);
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (int i = 0; i < static_cast<int>(numCells); ++i) {
+			centers[i] = minCorner_ + cellSize_ * Vector2(i % numCellsX_ + 0.5f, i / numCellsX_ + 0.5f);
+			blocked[i] = (sim->queryObstacleDistance(centers[i], radius) < radius);
+		}
+
+		/*
+		 * Connect each cell to its east, north-east, north and north-west
+		 * neighbors when visible, which covers all eight directions.
+		 */
+		const int offsetsX[4] = { 1, 1, 0, -1 };
+		const int offsetsY[4] = { 0, 1, 1, 1 };
+
+		std::vector<Vector2> points1(4 * numCells);
+		std::vector<Vector2> points2(4 * numCells);
+		std::vector<bool> visible;
+
+		for (size_t i = 0; i < numCells; ++i) {
+			const int x = static_cast<int>(i % numCellsX_);
+			const int y = static_cast<int>(i / numCellsX_);
+
+			for (size_t k = 0; k < 4; ++k) {
+				const int neighborX = x + offsetsX[k];
+				const int neighborY = y + offsetsY[k];
+
+				points1[4 * i + k] = centers[i];
+
+				if (neighborX >= 0 && neighborX < static_cast<int>(numCellsX_) && neighborY < static_cast<int>(numCellsY_)) {
+					points2[4 * i + k] = centers[neighborY * numCellsX_ + neighborX];
+				}
+				else {
+					/* Degenerate pair, skipped below. */
+					points2[4 * i + k] = centers[i];
+				}
+			}
+		}
+
+		sim->queryVisibility(points1, points2, visible, radius);
+
+		std::vector<float> distances(numCells, infinity);
+		std::vector<size_t> parents(numCells, numCells);
+		std::vector<size_t> order;
+		order.reserve(numCells);
+
+		std::priority_queue<std::pair<float, size_t>, std::vector<std::pair<float, size_t> >, std::greater<std::pair<float, size_t> > > queue;
+
+		if (sim->queryVisibility(centers[goalCell], goal_, radius)) {
+			distances[goalCell] = abs(centers[goalCell] - goal_);
+			queue.push(std::make_pair(distances[goalCell], goalCell));
+		}
+
+		while (!queue.empty()) {
+			const float distance = queue.top().first;
+			const size_t cell = queue.top().second;
+			queue.pop();
+
+			if (distance > distances[cell]) {
+				continue;
+			}
+
+			order.push_back(cell);
+
+			const int x = static_cast<int>(cell % numCellsX_);
+			const int y = static_cast<int>(cell / numCellsX_);
+
+			for (size_t k = 0; k < 8; ++k) {
+				/* Edges stored at this cell, then those stored at neighbors. */
+				const int sign = (k < 4 ? 1 : -1);
+				const int neighborX = x + sign * offsetsX[k % 4];
+				const int neighborY = y + sign * offsetsY[k % 4];
+
+				if (neighborX < 0 || neighborX >= static_cast<int>(numCellsX_) || neighborY < 0 || neighborY >= static_cast<int>(numCellsY_)) {
+					continue;
+				}
+
+				const size_t neighbor = neighborY * numCellsX_ + neighborX;
+
+				if (blocked[neighbor] || !visible[k < 4 ? 4 * cell + k : 4 * neighbor + k % 4]) {
+					continue;
+				}
+
+				const float neighborDistance = distance + cellSize_ * ((offsetsX[k % 4] != 0 && offsetsY[k % 4] != 0) ? std::sqrt(2.0f) : 1.0f);
+
+				if (neighborDistance < distances[neighbor]) {
+					distances[neighbor] = neighborDistance;
+					parents[neighbor] = cell;
+					queue.push(std::make_pair(neighborDistance, neighbor));
+				}
+			}
+		}
+
+		/*
+		 * Shorten the paths in order of increasing distance, so that the
+		 * waypoint of the parent of a cell is final when the cell is reached.
+		 */
+		for (size_t i = 0; i < order.size(); ++i) {
+			const size_t cell = order[i];
+			const size_t parent = parents[cell];
+
+			if (parent == numCells) {
+				waypoints_[cell] = goal_;
+				remaining_[cell] = 0.0f;
+			}
+			else if (sim->queryVisibility(centers[cell], waypoints_[parent], radius)) {
+				waypoints_[cell] = waypoints_[parent];
+				remaining_[cell] = remaining_[parent];
+			}
+			else {
+				waypoints_[cell] = centers[parent];
+				remaining_[cell] = abs(waypoints_[parent] - centers[parent]) + remaining_[parent];
+			}
+		}
+	}
+
+	size_t FlowField::getCell(const Vector2 &point) const
+	{
+		const float x = std::floor((point.x() - minCorner_.x()) / cellSize_);
+		const float y = std::floor((point.y() - minCorner_.y()) / cellSize_);
+
+		if (x < 0.0f || y < 0.0f || x >= numCellsX_ || y >= numCellsY_) {
+			return numCellsX_ * numCellsY_;
+		}
+
+		return static_cast<size_t>(y) * numCellsX_ + static_cast<size_t>(x);
+	}
+
+	Vector2 FlowField::getDirection(const Vector2 &point) const
+	{
+		const Vector2 waypoint = getWaypoint(point);
+
+		if (absSq(waypoint - point) > 0.0f) {
+			return normalize(waypoint - point);
+		}
+		else if (absSq(goal_ - point) > 0.0f) {
+			return normalize(goal_ - point);
+		}
+
+		return Vector2();
+	}
+
+	float FlowField::getDistance(const Vector2 &point) const
+	{
+		const size_t cell = getCell(point);
+
+		if (cell == remaining_.size() || remaining_[cell] == std::numeric_limits<float>::infinity()) {
+			return abs(goal_ - point);
+		}
+
+		return abs(waypoints_[cell] - point) + remaining_[cell];
+	}
+
+	const Vector2 &FlowField::getGoal() const
+	{
+		return goal_;
+	}
+
+	const Vector2 &FlowField::getWaypoint(const Vector2 &point) const
+	{
+		const size_t cell = getCell(point);
+
+		if (cell == waypoints_.size()) {
+			return goal_;
+		}
+
+		return waypoints_[cell];
+	}
+}
@@ -0,0 +1,117 @@
+/*
+ * FlowField.h
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef RVO_FLOW_FIELD_H_
+#define RVO_FLOW_FIELD_H_
+
+/**
+ * \file       FlowField.h
+ * \brief      Contains the FlowField class.
+ */
+
+#include <cstddef>
+#include <vector>
+
+#include "Vector2.h"
+
+namespace RVO {
+	class RVOSimulator;
+
+	/**
+	 * \brief      Defines a flow field that guides agents around the obstacles
+	 *             to a common goal.
+	 *
+	 * The field is computed once per goal with Dijkstra's algorithm over a
+	 * grid whose neighboring cell centers are connected when mutually
+	 * visible, leaving out cells whose center lies within the radius of an
+	 * obstacle. The resulting paths are shortened by letting each cell head
+	 * directly for the waypoint of its successor whenever it is visible.
+	 * Looking up the preferred direction of an agent then takes constant
+	 * time, independent of the number of agents sharing the goal.
+	 */
+	class FlowField {
+	public:
+		/**
+		 * \brief      Computes a flow field towards the specified goal.
+		 * \param      sim             The simulator instance whose processed
+		 *                             obstacles are to be avoided.
+		 * \param      goal            The two-dimensional goal position.
+		 * \param      minCorner       The corner of the area covered by the
+		 *                             field with the minimum coordinates.
+		 * \param      maxCorner       The corner of the area covered by the
+		 *                             field with the maximum coordinates.
+		 * \param      cellSize        The size of the grid cells. Must be
+		 *                             positive.
+		 * \param      radius          The minimal distance between the paths
+		 *                             and the obstacles, typically the agent
+		 *                             radius. Must be non-negative.
+		 */
+		FlowField(const RVOSimulator *sim, const Vector2 &goal,
+				  const Vector2 &minCorner, const Vector2 &maxCorner,
+				  float cellSize, float radius);
+
+		/**
+		 * \brief      Returns the direction in which to move from the specified
+		 *             point to follow the field to the goal.
+		 * \param      point           The two-dimensional point.
+		 * \return     The two-dimensional unit direction, straight towards the
+		 *             goal when the point is outside the field or cannot reach
+		 *             the goal, and zero at the goal.
+		 */
+		Vector2 getDirection(const Vector2 &point) const;
+
+		/**
+		 * \brief      Returns the length of the path from the specified point
+		 *             to the goal.
+		 * \param      point           The two-dimensional point.
+		 * \return     The length of the path, or the straight-line distance to
+		 *             the goal when the point is outside the field or cannot
+		 *             reach the goal.
+		 */
+		float getDistance(const Vector2 &point) const;
+
+		/**
+		 * \brief      Returns the goal of the field.
+		 * \return     The two-dimensional goal position.
+		 */
+		const Vector2 &getGoal() const;
+
+		/**
+		 * \brief      Returns the waypoint to head for from the specified point.
+		 * \param      point           The two-dimensional point.
+		 * \return     The two-dimensional waypoint, which is the goal when the
+		 *             point is outside the field or cannot reach the goal.
+		 */
+		const Vector2 &getWaypoint(const Vector2 &point) const;
+
+	private:
+		size_t getCell(const Vector2 &point) const;
+
+		float cellSize_;
+		Vector2 goal_;
+		Vector2 minCorner_;
+		size_t numCellsX_;
+		size_t numCellsY_;
+		std::vector<float> remaining_;
+		std::vector<Vector2> waypoints_;
+	};
+}
+
+#endif /* RVO_FLOW_FIELD_H_ */
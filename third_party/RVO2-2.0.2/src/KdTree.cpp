@@ -33,11 +33,12 @@
 #include "KdTree.h"
 
 #include "Agent.h"
+#include "AgentProfile.h"
 #include "RVOSimulator.h"
 #include "Obstacle.h"
 
 namespace RVO {
-	KdTree::KdTree(RVOSimulator *sim) : obstacleTree_(NULL), sim_(sim) { }
+	KdTree::KdTree(RVOSimulator *sim) : agentPositionsValid_(false), obstacleTree_(NULL), sim_(sim) { }
 
 	KdTree::~KdTree()
 	{
@@ -52,8 +53,22 @@ namespace RVO {
 			}
 
 			agentTree_.resize(2 * agents_.size() - 1);
+			agentPositionsValid_ = false;
 		}
 
+		/* Gather the positions, unless the last step already did so while updating the agents. */
+		if (!agentPositionsValid_) {
+			agentPositions_.resize(agents_.size());
+
+			for (size_t i = 0; i < agents_.size(); ++i) {
+				agentPositions_[i] = agents_[i]->position_;
+			}
+
+			agentPositionsValid_ = true;
+		}
+
+		agentLeaves_.clear();
+
 		if (!agents_.empty()) {
 			buildAgentTreeRecursive(0, agents_.size(), 0);
 		}
@@ -63,14 +78,14 @@ namespace RVO {
 	{
 		agentTree_[node].begin = begin;
 		agentTree_[node].end = end;
-		agentTree_[node].minX = agentTree_[node].maxX = agents_[begin]->position_.x();
-		agentTree_[node].minY = agentTree_[node].maxY = agents_[begin]->position_.y();
+		agentTree_[node].minX = agentTree_[node].maxX = agentPositions_[begin].x();
+		agentTree_[node].minY = agentTree_[node].maxY = agentPositions_[begin].y();
 
 		for (size_t i = begin + 1; i < end; ++i) {
-			agentTree_[node].maxX = std::max(agentTree_[node].maxX, agents_[i]->position_.x());
-			agentTree_[node].minX = std::min(agentTree_[node].minX, agents_[i]->position_.x());
-			agentTree_[node].maxY = std::max(agentTree_[node].maxY, agents_[i]->position_.y());
-			agentTree_[node].minY = std::min(agentTree_[node].minY, agents_[i]->position_.y());
+			agentTree_[node].maxX = std::max(agentTree_[node].maxX, agentPositions_[i].x());
+			agentTree_[node].minX = std::min(agentTree_[node].minX, agentPositions_[i].x());
+			agentTree_[node].maxY = std::max(agentTree_[node].maxY, agentPositions_[i].y());
+			agentTree_[node].minY = std::min(agentTree_[node].minY, agentPositions_[i].y());
 		}
 
 		if (end - begin > MAX_LEAF_SIZE) {
@@ -82,16 +97,17 @@ namespace RVO {
 			size_t right = end;
 
 			while (left < right) {
-				while (left < right && (isVertical ? agents_[left]->position_.x() : agents_[left]->position_.y()) < splitValue) {
+				while (left < right && (isVertical ? agentPositions_[left].x() : agentPositions_[left].y()) < splitValue) {
 					++left;
 				}
 
-				while (right > left && (isVertical ? agents_[right - 1]->position_.x() : agents_[right - 1]->position_.y()) >= splitValue) {
+				while (right > left && (isVertical ? agentPositions_[right - 1].x() : agentPositions_[right - 1].y()) >= splitValue) {
 					--right;
 				}
 
 				if (left < right) {
 					std::swap(agents_[left], agents_[right - 1]);
+					std::swap(agentPositions_[left], agentPositions_[right - 1]);
 					++left;
 					--right;
 				}
@@ -108,6 +124,9 @@ namespace RVO {
 			buildAgentTreeRecursive(begin, left, agentTree_[node].left);
 			buildAgentTreeRecursive(left, end, agentTree_[node].right);
 		}
+		else {
+			agentLeaves_.push_back(node);
+		}
 	}
 
 	void KdTree::buildObstacleTree()
@@ -222,6 +241,7 @@ namespace RVO {
 					newObstacle->id_ = sim_->obstacles_.size();
 
 					sim_->obstacles_.push_back(newObstacle);
+					++sim_->numSplitObstacles_;
 
 					obstacleJ1->nextObstacle_ = newObstacle;
 					obstacleJ2->prevObstacle_ = newObstacle;
@@ -249,11 +269,61 @@ namespace RVO {
 		queryAgentTreeRecursive(agent, rangeSq, 0);
 	}
 
+	void KdTree::computeAgentNeighbors(Agent *agent, float &rangeSq, const std::vector<std::pair<float, size_t> > &leaves) const
+	{
+		for (size_t i = 0; i < leaves.size(); ++i) {
+			/*
+			 * The distance between the leaves is a lower bound on the distance
+			 * between the agent and any agent in the candidate leaf.
+			 */
+			if (leaves[i].first >= rangeSq) {
+				break;
+			}
+
+			const AgentTreeNode &node = agentTree_[leaves[i].second];
+
+			const float distSq = sqr(std::max(0.0f, node.minX - agent->position_.x())) + sqr(std::max(0.0f, agent->position_.x() - node.maxX)) + sqr(std::max(0.0f, node.minY - agent->position_.y())) + sqr(std::max(0.0f, agent->position_.y() - node.maxY));
+
+			if (distSq < rangeSq) {
+				for (size_t j = node.begin; j < node.end; ++j) {
+					agent->insertAgentNeighbor(agents_[j], rangeSq);
+				}
+			}
+		}
+	}
+
+	void KdTree::computeLeafCandidates(size_t leaf, std::vector<std::pair<float, size_t> > &leaves) const
+	{
+		leaves.clear();
+
+		float range = 0.0f;
+
+		for (size_t i = agentTree_[leaf].begin; i < agentTree_[leaf].end; ++i) {
+			if (agents_[i]->profile_->maxNeighbors_ > 0) {
+				range = std::max(range, agents_[i]->profile_->neighborDist_);
+			}
+		}
+
+		if (range > 0.0f) {
+			queryLeafTreeRecursive(leaf, sqr(range), 0, leaves);
+			std::sort(leaves.begin(), leaves.end());
+		}
+	}
+
 	void KdTree::computeObstacleNeighbors(Agent *agent, float rangeSq) const
 	{
 		queryObstacleTreeRecursive(agent, rangeSq, obstacleTree_);
 	}
 
+	size_t KdTree::countObstacleTreeNodes(const ObstacleTreeNode *node) const
+	{
+		if (node == NULL) {
+			return 0;
+		}
+
+		return 1 + countObstacleTreeNodes(node->left) + countObstacleTreeNodes(node->right);
+	}
+
 	void KdTree::deleteObstacleTree(ObstacleTreeNode *node)
 	{
 		if (node != NULL) {
@@ -263,6 +333,70 @@ namespace RVO {
 		}
 	}
 
+	bool KdTree::loadObstacleTree(const std::vector<size_t> &nodes)
+	{
+		deleteObstacleTree(obstacleTree_);
+
+		size_t next = 0;
+		bool valid = true;
+		obstacleTree_ = loadObstacleTreeRecursive(nodes, next, valid);
+
+		if (!valid || next != nodes.size()) {
+			deleteObstacleTree(obstacleTree_);
+			obstacleTree_ = NULL;
+
+			return false;
+		}
+
+		return true;
+	}
+
+	KdTree::ObstacleTreeNode *KdTree::loadObstacleTreeRecursive(const std::vector<size_t> &nodes, size_t &next, bool &valid)
+	{
+		if (next >= nodes.size()) {
+			valid = false;
+			return NULL;
+		}
+
+		const size_t obstacleNo = nodes[next++];
+
+		if (obstacleNo == RVO_ERROR) {
+			return NULL;
+		}
+		else if (obstacleNo >= sim_->obstacles_.size()) {
+			valid = false;
+			return NULL;
+		}
+
+		ObstacleTreeNode *const node = new ObstacleTreeNode;
+		node->obstacle = sim_->obstacles_[obstacleNo];
+		node->left = valid ? loadObstacleTreeRecursive(nodes, next, valid) : NULL;
+		node->right = valid ? loadObstacleTreeRecursive(nodes, next, valid) : NULL;
+
+		return node;
+	}
+
+	void KdTree::queryAgentsInRadius(const Vector2 &point, float rangeSq, std::vector<size_t> &agentNos) const
+	{
+		if (!agents_.empty()) {
+			queryRadiusTreeRecursive(point, rangeSq, 0, agentNos);
+		}
+	}
+
+	void KdTree::queryAgentsInRect(const Vector2 &minCorner, const Vector2 &maxCorner, std::vector<size_t> &agentNos) const
+	{
+		if (!agents_.empty()) {
+			queryRectTreeRecursive(minCorner, maxCorner, 0, agentNos);
+		}
+	}
+
+	void KdTree::queryNearestAgents(const Vector2 &point, size_t numAgents, float rangeSq, std::vector<std::pair<float, size_t> > &neighbors) const
+	{
+		if (!agents_.empty() && numAgents > 0) {
+			queryNearestTreeRecursive(point, numAgents, rangeSq, 0, neighbors);
+		}
+	}
+
 	void KdTree::queryAgentTreeRecursive(Agent *agent, float &rangeSq, size_t node) const
 	{
 		if (agentTree_[node].end - agentTree_[node].begin <= MAX_LEAF_SIZE) {
@@ -297,6 +431,160 @@ namespace RVO {
 		}
 	}
 
+	void KdTree::queryNearestTreeRecursive(const Vector2 &point, size_t numAgents, float &rangeSq, size_t node, std::vector<std::pair<float, size_t> > &neighbors) const
+	{
+		if (agentTree_[node].end - agentTree_[node].begin <= MAX_LEAF_SIZE) {
+			for (size_t i = agentTree_[node].begin; i < agentTree_[node].end; ++i) {
+				const float distSq = absSq(point - agents_[i]->position_);
+
+				if (distSq < rangeSq) {
+					if (neighbors.size() < numAgents) {
+						neighbors.push_back(std::make_pair(distSq, agents_[i]->id_));
+					}
+
+					size_t j = neighbors.size() - 1;
+
+					while (j != 0 && distSq < neighbors[j - 1].first) {
+						neighbors[j] = neighbors[j - 1];
+						--j;
+					}
+
+					neighbors[j] = std::make_pair(distSq, agents_[i]->id_);
+
+					if (neighbors.size() == numAgents) {
+						rangeSq = neighbors.back().first;
+					}
+				}
+			}
+		}
+		else {
+			const AgentTreeNode &left = agentTree_[agentTree_[node].left];
+			const AgentTreeNode &right = agentTree_[agentTree_[node].right];
+
+			const float distSqLeft = sqr(std::max(0.0f, left.minX - point.x())) + sqr(std::max(0.0f, point.x() - left.maxX)) + sqr(std::max(0.0f, left.minY - point.y())) + sqr(std::max(0.0f, point.y() - left.maxY));
+			const float distSqRight = sqr(std::max(0.0f, right.minX - point.x())) + sqr(std::max(0.0f, point.x() - right.maxX)) + sqr(std::max(0.0f, right.minY - point.y())) + sqr(std::max(0.0f, point.y() - right.maxY));
+
+			if (distSqLeft < distSqRight) {
+				if (distSqLeft < rangeSq) {
+					queryNearestTreeRecursive(point, numAgents, rangeSq, agentTree_[node].left, neighbors);
+
+					if (distSqRight < rangeSq) {
+						queryNearestTreeRecursive(point, numAgents, rangeSq, agentTree_[node].right, neighbors);
+					}
+				}
+			}
+			else {
+				if (distSqRight < rangeSq) {
+					queryNearestTreeRecursive(point, numAgents, rangeSq, agentTree_[node].right, neighbors);
+
+					if (distSqLeft < rangeSq) {
+						queryNearestTreeRecursive(point, numAgents, rangeSq, agentTree_[node].left, neighbors);
+					}
+				}
+			}
+		}
+	}
+
+	void KdTree::queryRadiusTreeRecursive(const Vector2 &point, float rangeSq, size_t node, std::vector<size_t> &agentNos) const
+	{
+		const AgentTreeNode &treeNode = agentTree_[node];
+
+		const float distSq = sqr(std::max(0.0f, treeNode.minX - point.x())) + sqr(std::max(0.0f, point.x() - treeNode.maxX)) + sqr(std::max(0.0f, treeNode.minY - point.y())) + sqr(std::max(0.0f, point.y() - treeNode.maxY));
+
+		if (distSq > rangeSq) {
+			return;
+		}
+
+		if (treeNode.end - treeNode.begin <= MAX_LEAF_SIZE) {
+			for (size_t i = treeNode.begin; i < treeNode.end; ++i) {
+				if (absSq(point - agents_[i]->position_) <= rangeSq) {
+					agentNos.push_back(agents_[i]->id_);
+				}
+			}
+		}
+		else {
+			queryRadiusTreeRecursive(point, rangeSq, treeNode.left, agentNos);
+			queryRadiusTreeRecursive(point, rangeSq, treeNode.right, agentNos);
+		}
+	}
+
+	void KdTree::queryRectTreeRecursive(const Vector2 &minCorner, const Vector2 &maxCorner, size_t node, std::vector<size_t> &agentNos) const
+	{
+		const AgentTreeNode &treeNode = agentTree_[node];
+
+		if (treeNode.maxX < minCorner.x() || treeNode.minX > maxCorner.x() || treeNode.maxY < minCorner.y() || treeNode.minY > maxCorner.y()) {
+			return;
+		}
+
+		if (treeNode.minX >= minCorner.x() && treeNode.maxX <= maxCorner.x() && treeNode.minY >= minCorner.y() && treeNode.maxY <= maxCorner.y()) {
+			/* Node fully contained in rectangle. */
+			for (size_t i = treeNode.begin; i < treeNode.end; ++i) {
+				agentNos.push_back(agents_[i]->id_);
+			}
+		}
+		else if (treeNode.end - treeNode.begin <= MAX_LEAF_SIZE) {
+			for (size_t i = treeNode.begin; i < treeNode.end; ++i) {
+				const Vector2 &position = agents_[i]->position_;
+
+				if (position.x() >= minCorner.x() && position.x() <= maxCorner.x() && position.y() >= minCorner.y() && position.y() <= maxCorner.y()) {
+					agentNos.push_back(agents_[i]->id_);
+				}
+			}
+		}
+		else {
+			queryRectTreeRecursive(minCorner, maxCorner, treeNode.left, agentNos);
+			queryRectTreeRecursive(minCorner, maxCorner, treeNode.right, agentNos);
+		}
+	}
+
+	void KdTree::queryLeafTreeRecursive(size_t leaf, float rangeSq, size_t node, std::vector<std::pair<float, size_t> > &leaves) const
+	{
+		const AgentTreeNode &from = agentTree_[leaf];
+		const AgentTreeNode &to = agentTree_[node];
+
+		const float distSq = sqr(std::max(0.0f, std::max(to.minX - from.maxX, from.minX - to.maxX))) + sqr(std::max(0.0f, std::max(to.minY - from.maxY, from.minY - to.maxY)));
+
+		if (distSq >= rangeSq) {
+			return;
+		}
+
+		if (to.end - to.begin <= MAX_LEAF_SIZE) {
+			leaves.push_back(std::make_pair(distSq, node));
+		}
+		else {
+			queryLeafTreeRecursive(leaf, rangeSq, to.left, leaves);
+			queryLeafTreeRecursive(leaf, rangeSq, to.right, leaves);
+		}
+	}
+
+	void KdTree::queryObstacleDistance(const Vector2 &point, float &rangeSq) const
+	{
+		queryObstacleDistanceRecursive(point, rangeSq, obstacleTree_);
+	}
+
+	void KdTree::queryObstacleDistanceRecursive(const Vector2 &point, float &rangeSq, const ObstacleTreeNode *node) const
+	{
+		if (node == NULL) {
+			return;
+		}
+
+		const Obstacle *const obstacle1 = node->obstacle;
+		const Obstacle *const obstacle2 = obstacle1->nextObstacle_;
+
+		const float pointLeftOfLine = leftOf(obstacle1->point_, obstacle2->point_, point);
+
+		queryObstacleDistanceRecursive(point, rangeSq, (pointLeftOfLine >= 0.0f ? node->left : node->right));
+
+		const float distSqLine = sqr(pointLeftOfLine) / absSq(obstacle2->point_ - obstacle1->point_);
+
+		if (distSqLine < rangeSq) {
+			rangeSq = std::min(rangeSq, distSqPointLineSegment(obstacle1->point_, obstacle2->point_, point));
+
+			/* Try other side of line. */
+			queryObstacleDistanceRecursive(point, rangeSq, (pointLeftOfLine >= 0.0f ? node->right : node->left));
+		}
+	}
+
 	void KdTree::queryObstacleTreeRecursive(Agent *agent, float rangeSq, const ObstacleTreeNode *node) const
 	{
 		if (node == NULL) {
@@ -365,4 +653,171 @@ namespace RVO {
 			}
 		}
 	}
+
+	void KdTree::queryVisibility(const std::vector<Vector2> &points1, const std::vector<Vector2> &points2, float radius, size_t begin, size_t end, std::vector<char> &visible, std::vector<char> &masks, std::vector<size_t> &queries) const
+	{
+		queries.clear();
+
+		for (size_t i = begin; i < end; ++i) {
+			visible[i] = 1;
+			queries.push_back(i);
+		}
+
+		queryVisibilityRecursive(points1, points2, radius, 0, queries.size(), visible, masks, queries, obstacleTree_);
+	}
+
+	void KdTree::queryVisibilityRecursive(const std::vector<Vector2> &points1, const std::vector<Vector2> &points2, float radius, size_t begin, size_t end, std::vector<char> &visible, std::vector<char> &masks, std::vector<size_t> &queries, const ObstacleTreeNode *node) const
+	{
+		if (node == NULL || begin == end) {
+			return;
+		}
+
+		const Obstacle *const obstacle1 = node->obstacle;
+		const Obstacle *const obstacle2 = obstacle1->nextObstacle_;
+		const float invLengthI = 1.0f / absSq(obstacle2->point_ - obstacle1->point_);
+
+		enum { VISIT_LEFT = 1, VISIT_RIGHT = 2 };
+
+		/*
+		 * Decide for each pair which subtrees are to be visited, following the
+		 * cases of the single-pair query.
+		 */
+		for (size_t i = begin; i < end; ++i) {
+			const size_t q = queries[i];
+
+			if (!visible[q]) {
+				masks[q] = 0;
+				continue;
+			}
+
+			const Vector2 &q1 = points1[q];
+			const Vector2 &q2 = points2[q];
+
+			const float q1LeftOfI = leftOf(obstacle1->point_, obstacle2->point_, q1);
+			const float q2LeftOfI = leftOf(obstacle1->point_, obstacle2->point_, q2);
+
+			if (q1LeftOfI >= 0.0f && q2LeftOfI >= 0.0f) {
+				masks[q] = VISIT_LEFT | ((sqr(q1LeftOfI) * invLengthI >= sqr(radius) && sqr(q2LeftOfI) * invLengthI >= sqr(radius)) ? 0 : VISIT_RIGHT);
+			}
+			else if (q1LeftOfI <= 0.0f && q2LeftOfI <= 0.0f) {
+				masks[q] = VISIT_RIGHT | ((sqr(q1LeftOfI) * invLengthI >= sqr(radius) && sqr(q2LeftOfI) * invLengthI >= sqr(radius)) ? 0 : VISIT_LEFT);
+			}
+			else if (q1LeftOfI >= 0.0f && q2LeftOfI <= 0.0f) {
+				/* One can see through obstacle from left to right. */
+				masks[q] = VISIT_LEFT | VISIT_RIGHT;
+			}
+			else {
+				const float point1LeftOfQ = leftOf(q1, q2, obstacle1->point_);
+				const float point2LeftOfQ = leftOf(q1, q2, obstacle2->point_);
+				const float invLengthQ = 1.0f / absSq(q2 - q1);
+
+				if (point1LeftOfQ * point2LeftOfQ >= 0.0f && sqr(point1LeftOfQ) * invLengthQ > sqr(radius) && sqr(point2LeftOfQ) * invLengthQ > sqr(radius)) {
+					masks[q] = VISIT_LEFT | VISIT_RIGHT;
+				}
+				else {
+					visible[q] = 0;
+					masks[q] = 0;
+				}
+			}
+		}
+
+		/*
+		 * Both lists are built before descending, as the masks are overwritten
+		 * further down the tree.
+		 */
+		const size_t leftBegin = queries.size();
+
+		for (size_t i = begin; i < end; ++i) {
+			if (masks[queries[i]] & VISIT_LEFT) {
+				queries.push_back(queries[i]);
+			}
+		}
+
+		const size_t rightBegin = queries.size();
+
+		for (size_t i = begin; i < end; ++i) {
+			if (masks[queries[i]] & VISIT_RIGHT) {
+				queries.push_back(queries[i]);
+			}
+		}
+
+		const size_t rightEnd = queries.size();
+
+		queryVisibilityRecursive(points1, points2, radius, leftBegin, rightBegin, visible, masks, queries, node->left);
+		queries.resize(rightEnd);
+		queryVisibilityRecursive(points1, points2, radius, rightBegin, rightEnd, visible, masks, queries, node->right);
+		queries.resize(leftBegin);
+	}
+
+	const Obstacle *KdTree::raycast(const Vector2 &q1, const Vector2 &q2, float &t) const
+	{
+		const Obstacle *obstacle = NULL;
+		t = 1.0f;
+		raycastRecursive(q1, q2, t, obstacle, obstacleTree_);
+
+		return obstacle;
+	}
+
+	void KdTree::raycastRecursive(const Vector2 &q1, const Vector2 &q2, float &t, const Obstacle *&obstacle, const ObstacleTreeNode *node) const
+	{
+		if (node == NULL) {
+			return;
+		}
+
+		const Obstacle *const obstacle1 = node->obstacle;
+		const Obstacle *const obstacle2 = obstacle1->nextObstacle_;
+
+		/* Only the part of the segment before the nearest hit so far matters. */
+		const Vector2 end = q1 + t * (q2 - q1);
+
+		const float q1LeftOfI = leftOf(obstacle1->point_, obstacle2->point_, q1);
+		const float endLeftOfI = leftOf(obstacle1->point_, obstacle2->point_, end);
+
+		/* Visit the side of the start point first. */
+		const ObstacleTreeNode *const nearNode = (q1LeftOfI >= 0.0f ? node->left : node->right);
+		const ObstacleTreeNode *const farNode = (q1LeftOfI >= 0.0f ? node->right : node->left);
+
+		raycastRecursive(q1, q2, t, obstacle, nearNode);
+
+		if ((q1LeftOfI >= 0.0f && endLeftOfI >= 0.0f) || (q1LeftOfI < 0.0f && endLeftOfI < 0.0f)) {
+			/* Segment does not cross the line of this node. */
+			if (std::fabs(endLeftOfI) > RVO_EPSILON && std::fabs(q1LeftOfI) > RVO_EPSILON) {
+				return;
+			}
+		}
+
+		const Vector2 obstacleVector = obstacle2->point_ - obstacle1->point_;
+		const Vector2 segmentVector = q2 - q1;
+		const float denominator = det(segmentVector, obstacleVector);
+
+		if (std::fabs(denominator) > RVO_EPSILON) {
+			const float s = det(obstacle1->point_ - q1, obstacleVector) / denominator;
+			const float u = det(obstacle1->point_ - q1, segmentVector) / denominator;
+
+			if (s >= 0.0f && s < t && u >= 0.0f && u <= 1.0f) {
+				t = s;
+				obstacle = obstacle1;
+			}
+		}
+
+		raycastRecursive(q1, q2, t, obstacle, farNode);
+	}
+
+	void KdTree::saveObstacleTree(std::vector<size_t> &nodes) const
+	{
+		nodes.clear();
+		saveObstacleTreeRecursive(nodes, obstacleTree_);
+	}
+
+	void KdTree::saveObstacleTreeRecursive(std::vector<size_t> &nodes, const ObstacleTreeNode *node) const
+	{
+		if (node == NULL) {
+			nodes.push_back(RVO_ERROR);
+		}
+		else {
+			nodes.push_back(node->obstacle->id_);
+			saveObstacleTreeRecursive(nodes, node->left);
+			saveObstacleTreeRecursive(nodes, node->right);
+		}
+	}
 }
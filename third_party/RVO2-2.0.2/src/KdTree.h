@@ -148,6 +148,31 @@ namespace RVO {
 		 */
 		void computeAgentNeighbors(Agent *agent, float &rangeSq) const;
 
+		/**
+		 * \brief      Computes the agent neighbors of the specified agent from a
+		 *             precomputed set of candidate leaves.
+		 * \param      agent           A pointer to the agent for which agent
+		 *                             neighbors are to be computed.
+		 * \param      rangeSq         The squared range around the agent.
+		 * \param      leaves          The candidate leaves, sorted by squared
+		 *                             distance to the leaf containing the agent.
+		 */
+		void computeAgentNeighbors(Agent *agent, float &rangeSq,
+								   const std::vector<std::pair<float, size_t> > &
+								   leaves) const;
+
+		/**
+		 * \brief      Computes the leaves of the agent <i>k</i>d-tree that may
+		 *             contain agent neighbors of any agent in the specified leaf.
+		 * \param      leaf            The node number of the leaf.
+		 * \param      leaves          The candidate leaves with their squared
+		 *                             distance to the specified leaf, sorted by
+		 *                             distance.
+		 */
+		void computeLeafCandidates(size_t leaf,
+								   std::vector<std::pair<float, size_t> > &
+								   leaves) const;
+
 		/**
 		 * \brief      Computes the obstacle neighbors of the specified agent.
 		 * \param      agent           A pointer to the agent for which obstacle
@@ -156,6 +181,13 @@ namespace RVO {
 		 */
 		void computeObstacleNeighbors(Agent *agent, float rangeSq) const;
 
+		/**
+		 * \brief      Returns the number of nodes of an obstacle subtree.
+		 * \param      node            The root of the subtree.
+		 * \return     The number of nodes of the subtree.
+		 */
+		size_t countObstacleTreeNodes(const ObstacleTreeNode *node) const;
+
 		/**
 		 * \brief      Deletes the specified obstacle tree node.
 		 * \param      node            A pointer to the obstacle tree node to be
@@ -163,9 +195,91 @@ namespace RVO {
 		 */
 		void deleteObstacleTree(ObstacleTreeNode *node);
 
+		/**
+		 * \brief      Restores the obstacle <i>k</i>d-tree from the obstacle
+		 *             numbers of its nodes in preorder.
+		 * \param      nodes           The obstacle numbers of the nodes in
+		 *                             preorder, with RVO::RVO_ERROR for empty
+		 *                             subtrees, as returned by saveObstacleTree.
+		 * \return     True if the nodes describe a valid tree over the obstacles
+		 *             of the simulation.
+		 */
+		bool loadObstacleTree(const std::vector<size_t> &nodes);
+
+		ObstacleTreeNode *loadObstacleTreeRecursive(const std::vector<size_t> &
+													nodes, size_t &next,
+													bool &valid);
+
+		/**
+		 * \brief      Computes the agents within the specified range of the
+		 *             specified point.
+		 * \param      point           The point of the query.
+		 * \param      rangeSq         The squared range around the point.
+		 * \param      agentNos        The numbers of the agents found.
+		 */
+		void queryAgentsInRadius(const Vector2 &point, float rangeSq,
+								 std::vector<size_t> &agentNos) const;
+
+		/**
+		 * \brief      Computes the agents within the specified axis-aligned
+		 *             rectangle.
+		 * \param      minCorner       The corner of the rectangle with the
+		 *                             minimum coordinates.
+		 * \param      maxCorner       The corner of the rectangle with the
+		 *                             maximum coordinates.
+		 * \param      agentNos        The numbers of the agents found.
+		 */
+		void queryAgentsInRect(const Vector2 &minCorner,
+							   const Vector2 &maxCorner,
+							   std::vector<size_t> &agentNos) const;
+
+		/**
+		 * \brief      Computes the agents nearest to the specified point.
+		 * \param      point           The point of the query.
+		 * \param      numAgents       The maximum number of agents.
+		 * \param      rangeSq         The squared range around the point.
+		 * \param      neighbors       The squared distances and numbers of the
+		 *                             agents found, sorted by distance.
+		 */
+		void queryNearestAgents(const Vector2 &point, size_t numAgents,
+								float rangeSq,
+								std::vector<std::pair<float, size_t> > &
+								neighbors) const;
+
 		void queryAgentTreeRecursive(Agent *agent, float &rangeSq,
 									 size_t node) const;
 
+		void queryRadiusTreeRecursive(const Vector2 &point, float rangeSq,
+									  size_t node,
+									  std::vector<size_t> &agentNos) const;
+
+		void queryRectTreeRecursive(const Vector2 &minCorner,
+									const Vector2 &maxCorner, size_t node,
+									std::vector<size_t> &agentNos) const;
+
+		void queryNearestTreeRecursive(const Vector2 &point, size_t numAgents,
+									   float &rangeSq, size_t node,
+									   std::vector<std::pair<float, size_t> > &
+									   neighbors) const;
+
+		void queryLeafTreeRecursive(size_t leaf, float rangeSq, size_t node,
+									std::vector<std::pair<float, size_t> > &
+									leaves) const;
+
+		/**
+		 * \brief      Computes the squared distance from the specified point to
+		 *             the nearest obstacle edge within the specified range.
+		 * \param      point           The point of the query.
+		 * \param      rangeSq         The squared range around the point. Set
+		 *                             to the squared distance to the nearest
+		 *                             obstacle edge if it is nearer.
+		 */
+		void queryObstacleDistance(const Vector2 &point, float &rangeSq) const;
+
+		void queryObstacleDistanceRecursive(const Vector2 &point,
+											float &rangeSq,
+											const ObstacleTreeNode *node) const;
+
 		void queryObstacleTreeRecursive(Agent *agent, float rangeSq,
 										const ObstacleTreeNode *node) const;
 
@@ -188,7 +302,69 @@ namespace RVO {
 									  float radius,
 									  const ObstacleTreeNode *node) const;
 
+		/**
+		 * \brief      Queries the visibility between several pairs of points
+		 *             within a specified radius, sharing a single traversal of
+		 *             the obstacle <i>k</i>d-tree.
+		 * \param      points1         The first points of the pairs.
+		 * \param      points2         The second points of the pairs.
+		 * \param      radius          The radius within which visibility is to
+		 *                             be tested.
+		 * \param      begin           The number of the first pair to query.
+		 * \param      end             One past the number of the last pair to
+		 *                             query.
+		 * \param      visible         Set to nonzero for each pair in the range
+		 *                             whose points are mutually visible within
+		 *                             the radius, and to zero otherwise.
+		 * \param      masks           Scratch space of the same size as visible.
+		 * \param      queries         Scratch space.
+		 */
+		void queryVisibility(const std::vector<Vector2> &points1,
+							 const std::vector<Vector2> &points2, float radius,
+							 size_t begin, size_t end,
+							 std::vector<char> &visible,
+							 std::vector<char> &masks,
+							 std::vector<size_t> &queries) const;
+
+		void queryVisibilityRecursive(const std::vector<Vector2> &points1,
+									  const std::vector<Vector2> &points2,
+									  float radius, size_t begin, size_t end,
+									  std::vector<char> &visible,
+									  std::vector<char> &masks,
+									  std::vector<size_t> &queries,
+									  const ObstacleTreeNode *node) const;
+
+		/**
+		 * \brief      Computes the first obstacle edge hit by the segment
+		 *             between two points.
+		 * \param      q1              The start point of the segment.
+		 * \param      q2              The end point of the segment.
+		 * \param      t               The fraction of the segment up to the
+		 *                             nearest hit, which is 1 if nothing is hit.
+		 * \return     The first obstacle of the edge that is hit, or NULL.
+		 */
+		const Obstacle *raycast(const Vector2 &q1, const Vector2 &q2,
+								float &t) const;
+
+		void raycastRecursive(const Vector2 &q1, const Vector2 &q2, float &t,
+							  const Obstacle *&obstacle,
+							  const ObstacleTreeNode *node) const;
+
+		/**
+		 * \brief      Returns the obstacle numbers of the nodes of the obstacle
+		 *             <i>k</i>d-tree in preorder.
+		 * \param      nodes           The obstacle numbers of the nodes, with
+		 *                             RVO::RVO_ERROR for empty subtrees.
+		 */
+		void saveObstacleTree(std::vector<size_t> &nodes) const;
+
+		void saveObstacleTreeRecursive(std::vector<size_t> &nodes,
+									   const ObstacleTreeNode *node) const;
+
 		std::vector<Agent *> agents_;
+		std::vector<size_t> agentLeaves_;
+		std::vector<Vector2> agentPositions_;
+		bool agentPositionsValid_;
 		std::vector<AgentTreeNode> agentTree_;
 		ObstacleTreeNode *obstacleTree_;
 		RVOSimulator *sim_;
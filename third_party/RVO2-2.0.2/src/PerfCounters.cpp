@@ -0,0 +1,239 @@
+/*
+ * PerfCounters.cpp
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+
+#include "PerfCounters.h"
+
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace RVO {
+	namespace {
+		/* Written by its thread only, except when no step runs. */
+		struct PerfThreadState {
+			int fds[PerfCounters::NUM_COUNTERS];
+			size_t generation;
+			int leader;
+			size_t numOpen;
+			unsigned long long totals[PerfCounters::NUM_PHASES][PerfCounters::NUM_COUNTERS];
+		};
+
+		std::mutex perfMutex;
+		std::vector<PerfThreadState *> perfStates;
+		bool perfAvailable[PerfCounters::NUM_COUNTERS] = { };
+		size_t perfGeneration = 0;
+		thread_local PerfThreadState *threadPerfState = NULL;
+
+		void closeCounters(PerfThreadState *state)
+		{
+			for (size_t i = 0; i < PerfCounters::NUM_COUNTERS; ++i) {
+#ifdef __linux__
+				if (state->fds[i] >= 0) {
+					close(state->fds[i]);
+				}
+#endif
+				state->fds[i] = -1;
+			}
+
+			state->leader = -1;
+			state->numOpen = 0;
+		}
+
+		/* Opens the available counters of the calling thread as one group, so that they are read at once. */
+		void openCounters(PerfThreadState *state)
+		{
+			closeCounters(state);
+			state->generation = perfGeneration;
+
+#ifdef __linux__
+			const unsigned long long configs[PerfCounters::NUM_COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+			for (size_t i = 0; i < PerfCounters::NUM_COUNTERS; ++i) {
+				perf_event_attr attr;
+				std::memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.config = configs[i];
+				attr.read_format = PERF_FORMAT_GROUP;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+
+				const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, state->leader, 0));
+
+				if (fd >= 0) {
+					state->fds[i] = fd;
+					++state->numOpen;
+
+					if (state->leader < 0) {
+						state->leader = fd;
+					}
+				}
+			}
+#endif
+		}
+
+		PerfThreadState *getPerfThreadState()
+		{
+			if (threadPerfState == NULL) {
+				threadPerfState = new PerfThreadState();
+
+				for (size_t i = 0; i < PerfCounters::NUM_COUNTERS; ++i) {
+					threadPerfState->fds[i] = -1;
+				}
+
+				threadPerfState->leader = -1;
+				threadPerfState->generation = static_cast<size_t>(-1);
+
+				std::lock_guard<std::mutex> lock(perfMutex);
+				perfStates.push_back(threadPerfState);
+			}
+
+			if (threadPerfState->generation != perfGeneration) {
+				openCounters(threadPerfState);
+			}
+
+			return threadPerfState;
+		}
+
+		/* The group is read in the order its counters were opened. */
+		void readCounters(const PerfThreadState *state, unsigned long long values[PerfCounters::NUM_COUNTERS])
+		{
+			std::memset(values, 0, PerfCounters::NUM_COUNTERS * sizeof(unsigned long long));
+
+#ifdef __linux__
+			unsigned long long buffer[1 + PerfCounters::NUM_COUNTERS];
+
+			if (state->leader < 0 || read(state->leader, buffer, sizeof(buffer)) < static_cast<ssize_t>((1 + state->numOpen) * sizeof(unsigned long long))) {
+				return;
+			}
+
+			size_t j = 1;
+
+			for (size_t i = 0; i < PerfCounters::NUM_COUNTERS; ++i) {
+				if (state->fds[i] >= 0) {
+					values[i] = buffer[j++];
+				}
+			}
+#else
+			static_cast<void>(state);
+#endif
+		}
+	}
+
+	bool PerfCounters::enabled_ = false;
+
+	void PerfCounters::begin(unsigned long long values[NUM_COUNTERS])
+	{
+		readCounters(getPerfThreadState(), values);
+	}
+
+	void PerfCounters::disable()
+	{
+		std::lock_guard<std::mutex> lock(perfMutex);
+
+		enabled_ = false;
+		++perfGeneration;
+
+		for (size_t i = 0; i < perfStates.size(); ++i) {
+			closeCounters(perfStates[i]);
+		}
+	}
+
+	bool PerfCounters::enable()
+	{
+		disable();
+		reset();
+
+		const PerfThreadState *const state = getPerfThreadState();
+
+		for (size_t i = 0; i < NUM_COUNTERS; ++i) {
+			perfAvailable[i] = state->fds[i] >= 0;
+		}
+
+		enabled_ = state->numOpen > 0;
+
+		return enabled_;
+	}
+
+	void PerfCounters::end(Phase phase, const unsigned long long values[NUM_COUNTERS])
+	{
+		PerfThreadState *const state = getPerfThreadState();
+		unsigned long long now[NUM_COUNTERS];
+		readCounters(state, now);
+
+		for (size_t i = 0; i < NUM_COUNTERS; ++i) {
+			state->totals[phase][i] += now[i] - values[i];
+		}
+	}
+
+	const char *PerfCounters::getName(Counter counter)
+	{
+		static const char *const names[NUM_COUNTERS] = { "cycles", "instructions", "cache misses", "branch misses" };
+
+		return names[counter];
+	}
+
+	const char *PerfCounters::getName(Phase phase)
+	{
+		static const char *const names[NUM_PHASES] = { "buildAgentTree", "computeNewVelocity", "updateAgents" };
+
+		return names[phase];
+	}
+
+	unsigned long long PerfCounters::getTotal(Phase phase, Counter counter)
+	{
+		std::lock_guard<std::mutex> lock(perfMutex);
+
+		unsigned long long total = 0;
+
+		for (size_t i = 0; i < perfStates.size(); ++i) {
+			total += perfStates[i]->totals[phase][counter];
+		}
+
+		return total;
+	}
+
+	bool PerfCounters::isAvailable(Counter counter)
+	{
+		return enabled_ && perfAvailable[counter];
+	}
+
+	bool PerfCounters::isEnabled()
+	{
+		return enabled_;
+	}
+
+	void PerfCounters::reset()
+	{
+		std::lock_guard<std::mutex> lock(perfMutex);
+
+		for (size_t i = 0; i < perfStates.size(); ++i) {
+			std::memset(perfStates[i]->totals, 0, sizeof(perfStates[i]->totals));
+		}
+	}
+}
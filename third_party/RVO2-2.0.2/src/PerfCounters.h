@@ -0,0 +1,180 @@
+/*
+ * PerfCounters.h
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+
+#ifndef RVO_PERF_COUNTERS_H_
+#define RVO_PERF_COUNTERS_H_
+
+/**
+ * \file       PerfCounters.h
+ * \brief      Contains the PerfCounters and PerfScope classes.
+ */
+
+#include <cstddef>
+
+namespace RVO {
+	/**
+	 * \brief      Samples hardware performance counters around the phases of
+	 *             a simulation step, on Linux through perf_event_open.
+	 *
+	 * Every thread opens its own counters on its first phase after the
+	 * counters are enabled and adds the counts of its phases to totals of
+	 * its own, which are summed when queried. Counters that the processor or
+	 * the perf_event_paranoid setting do not allow are left out; when none
+	 * can be opened, enable fails and the phases are not sampled.
+	 */
+	class PerfCounters {
+	public:
+		/**
+		 * \brief      Defines the sampled phases of a simulation step.
+		 */
+		enum Phase {
+			BUILD_AGENT_TREE,
+			COMPUTE_NEW_VELOCITY,
+			UPDATE_AGENTS,
+			NUM_PHASES
+		};
+
+		/**
+		 * \brief      Defines the sampled hardware counters.
+		 */
+		enum Counter {
+			CYCLES,
+			INSTRUCTIONS,
+			CACHE_MISSES,
+			BRANCH_MISSES,
+			NUM_COUNTERS
+		};
+
+		/**
+		 * \brief      Stops sampling and closes the counters of all threads.
+		 *
+		 * Must not be called while a simulation step runs.
+		 */
+		static void disable();
+
+		/**
+		 * \brief      Starts sampling the phases of the following steps.
+		 * \return     True if at least one counter could be opened on the
+		 *             calling thread.
+		 */
+		static bool enable();
+
+		/**
+		 * \brief      Returns the name of a counter.
+		 * \param      counter         The counter.
+		 * \return     The name of the counter.
+		 */
+		static const char *getName(Counter counter);
+
+		/**
+		 * \brief      Returns the name of a phase.
+		 * \param      phase           The phase.
+		 * \return     The name of the phase.
+		 */
+		static const char *getName(Phase phase);
+
+		/**
+		 * \brief      Returns the count of a phase summed over all threads
+		 *             since the counters were enabled or reset.
+		 * \param      phase           The phase.
+		 * \param      counter         The counter.
+		 * \return     The count.
+		 */
+		static unsigned long long getTotal(Phase phase, Counter counter);
+
+		/**
+		 * \brief      Returns whether a counter could be opened when the
+		 *             counters were enabled.
+		 * \param      counter         The counter.
+		 * \return     True if the counter is sampled.
+		 */
+		static bool isAvailable(Counter counter);
+
+		/**
+		 * \brief      Returns whether the phases are sampled.
+		 * \return     True if the counters are enabled.
+		 */
+		static bool isEnabled();
+
+		/**
+		 * \brief      Sets the totals of all threads to zero.
+		 *
+		 * Must not be called while a simulation step runs.
+		 */
+		static void reset();
+
+	private:
+		static void begin(unsigned long long values[NUM_COUNTERS]);
+
+		static void end(Phase phase, const unsigned long long values[NUM_COUNTERS]);
+
+		static bool enabled_;
+
+		friend class PerfScope;
+	};
+
+	/**
+	 * \brief      Adds the counts from its construction to its destruction or
+	 *             an earlier call to end to the totals of a phase, when the
+	 *             counters are enabled.
+	 */
+	class PerfScope {
+	public:
+		/**
+		 * \brief      Starts counting a phase.
+		 * \param      phase           The phase.
+		 */
+		explicit PerfScope(PerfCounters::Phase phase) : active_(PerfCounters::enabled_), phase_(phase)
+		{
+			if (active_) {
+				PerfCounters::begin(values_);
+			}
+		}
+
+		/**
+		 * \brief      Stops counting the phase unless it was stopped already.
+		 */
+		~PerfScope() { end(); }
+
+		/**
+		 * \brief      Stops counting the phase and adds the counts to its
+		 *             totals.
+		 */
+		void end()
+		{
+			if (active_) {
+				PerfCounters::end(phase_, values_);
+				active_ = false;
+			}
+		}
+
+	private:
+		PerfScope(const PerfScope &other);
+		PerfScope &operator=(const PerfScope &other);
+
+		bool active_;
+		PerfCounters::Phase phase_;
+		unsigned long long values_[PerfCounters::NUM_COUNTERS];
+	};
+}
+
+#endif /* RVO_PERF_COUNTERS_H_ */
@@ -33,8 +33,10 @@
 #ifndef RVO_RVO_H_
 #define RVO_RVO_H_
 
+#include "FlowField.h"
 #include "RVOSimulator.h"
 #include "Vector2.h"
+#include "VisibilityCache.h"
 
 /**
 
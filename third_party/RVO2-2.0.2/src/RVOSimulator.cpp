@@ -33,31 +33,107 @@
 #include "RVOSimulator.h"
 
 #include "Agent.h"
+#include "AgentProfile.h"
+#include "ConstraintCapture.h"
 #include "KdTree.h"
 #include "Obstacle.h"
+#include "PerfCounters.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <fstream>
+#include <iterator>
 
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
 namespace RVO {
-	RVOSimulator::RVOSimulator() : defaultAgent_(NULL), globalTime_(0.0f), kdTree_(NULL), timeStep_(0.0f)
+	/**
+	 * \brief      Identifies a serialized simulator state.
+	 */
+	const unsigned int RVO_STATE_MAGIC = 0x534f5652;
+
+	/**
+	 * \brief      The version of the serialized simulator state.
+	 */
+	const unsigned int RVO_STATE_VERSION = 7;
+
+	/**
+	 * \brief      Computes the neighbors and new velocities of the agents in a
+	 *             range of leaves or agents of the agent <i>k</i>d-tree.
+	 */
+	class RVOSimulator::NewVelocityTask : public ThreadPool::Task {
+	public:
+		NewVelocityTask(const RVOSimulator *sim, ThreadSolverStats *stats, std::vector<Line> *projLines) : leaves_(sim->threadPool_->getNumThreads()), projLines_(projLines), sim_(sim), stats_(stats) { }
+
+		void run(size_t begin, size_t end, size_t threadNo)
+		{
+			RVO_TRACE_SCOPE("computeNewVelocity");
+			PerfScope perfScope(PerfCounters::COMPUTE_NEW_VELOCITY);
+
+			const KdTree *const kdTree = sim_->kdTree_;
+			SolverStats &stats = stats_[threadNo].stats;
+			std::vector<Line> &projLines = projLines_[threadNo];
+
+			if (sim_->neighborQueryBatching_) {
+				std::vector<std::pair<float, size_t> > &leaves = leaves_[threadNo];
+
+				for (size_t i = begin; i < end; ++i) {
+					const size_t leaf = kdTree->agentLeaves_[i];
+					kdTree->computeLeafCandidates(leaf, leaves);
+
+					for (size_t j = kdTree->agentTree_[leaf].begin; j < kdTree->agentTree_[leaf].end; ++j) {
+						kdTree->agents_[j]->computeNeighbors(leaves);
+						kdTree->agents_[j]->computeNewVelocity(stats, projLines);
+					}
+				}
+			}
+			else {
+				for (size_t i = begin; i < end; ++i) {
+					kdTree->agents_[i]->computeNeighbors();
+					kdTree->agents_[i]->computeNewVelocity(stats, projLines);
+				}
+			}
+		}
+
+	private:
+		std::vector<std::vector<std::pair<float, size_t> > > leaves_;
+		std::vector<Line> *projLines_;
+		const RVOSimulator *sim_;
+		ThreadSolverStats *stats_;
+	};
+
+	/**
+	 * \brief      Updates the positions and velocities of a range of agents in
+	 *             <i>k</i>d-tree order and gathers their positions for the next
+	 *             build of the agent <i>k</i>d-tree.
+	 */
+	class RVOSimulator::UpdateTask : public ThreadPool::Task {
+	public:
+		explicit UpdateTask(const RVOSimulator *sim) : sim_(sim) { }
+
+		void run(size_t begin, size_t end, size_t)
+		{
+			RVO_TRACE_SCOPE("updateAgents");
+			PerfScope perfScope(PerfCounters::UPDATE_AGENTS);
+
+			sim_->updateAgents(begin, end);
+		}
+
+	private:
+		const RVOSimulator *sim_;
+	};
+
+	RVOSimulator::RVOSimulator() : agentTreeDirty_(true), constraintCaptureStep_(0), constraintCapturing_(false), defaultAgent_(NULL), globalTime_(0.0f), kdTree_(NULL), linearProgramRandomOrder_(false), linearProgramWarmStart_(false), neighborQueryBatching_(false), numSplitObstacles_(0), numSteps_(0), numThreads_(0), threadPool_(NULL), timeStep_(0.0f), workStealing_(false)
 	{
 		kdTree_ = new KdTree(this);
 	}
 
-	RVOSimulator::RVOSimulator(float timeStep, float neighborDist, size_t maxNeighbors, float timeHorizon, float timeHorizonObst, float radius, float maxSpeed, const Vector2 &velocity) : defaultAgent_(NULL), globalTime_(0.0f), kdTree_(NULL), timeStep_(timeStep)
+	RVOSimulator::RVOSimulator(float timeStep, float neighborDist, size_t maxNeighbors, float timeHorizon, float timeHorizonObst, float radius, float maxSpeed, const Vector2 &velocity) : agentTreeDirty_(true), constraintCaptureStep_(0), constraintCapturing_(false), defaultAgent_(NULL), globalTime_(0.0f), kdTree_(NULL), linearProgramRandomOrder_(false), linearProgramWarmStart_(false), neighborQueryBatching_(false), numSplitObstacles_(0), numSteps_(0), numThreads_(0), threadPool_(NULL), timeStep_(timeStep), workStealing_(false)
 	{
 		kdTree_ = new KdTree(this);
-		defaultAgent_ = new Agent(this);
-
-		defaultAgent_->maxNeighbors_ = maxNeighbors;
-		defaultAgent_->maxSpeed_ = maxSpeed;
-		defaultAgent_->neighborDist_ = neighborDist;
-		defaultAgent_->radius_ = radius;
-		defaultAgent_->timeHorizon_ = timeHorizon;
-		defaultAgent_->timeHorizonObst_ = timeHorizonObst;
-		defaultAgent_->velocity_ = velocity;
+		setAgentDefaults(neighborDist, maxNeighbors, timeHorizon, timeHorizonObst, radius, maxSpeed, velocity);
 	}
 
 	RVOSimulator::~RVOSimulator()
@@ -74,7 +150,12 @@ namespace RVO {
 			delete obstacles_[i];
 		}
 
+		for (size_t i = 0; i < profiles_.size(); ++i) {
+			delete profiles_[i];
+		}
+
 		delete kdTree_;
+		delete threadPool_;
 	}
 
 	size_t RVOSimulator::addAgent(const Vector2 &position)
@@ -86,39 +167,80 @@ namespace RVO {
 		Agent *agent = new Agent(this);
 
 		agent->position_ = position;
-		agent->maxNeighbors_ = defaultAgent_->maxNeighbors_;
-		agent->maxSpeed_ = defaultAgent_->maxSpeed_;
-		agent->neighborDist_ = defaultAgent_->neighborDist_;
-		agent->radius_ = defaultAgent_->radius_;
-		agent->timeHorizon_ = defaultAgent_->timeHorizon_;
-		agent->timeHorizonObst_ = defaultAgent_->timeHorizonObst_;
+		agent->profile_ = defaultAgent_->profile_;
 		agent->velocity_ = defaultAgent_->velocity_;
 
-		agent->id_ = agents_.size();
+		return insertAgent(agent);
+	}
 
-		agents_.push_back(agent);
+	size_t RVOSimulator::addAgent(const Vector2 &position, size_t profileNo)
+	{
+		if (profileNo >= profiles_.size()) {
+			return RVO_ERROR;
+		}
 
-		return agents_.size() - 1;
+		Agent *agent = new Agent(this);
+
+		agent->position_ = position;
+		agent->profile_ = profiles_[profileNo];
+
+		if (defaultAgent_ != NULL) {
+			agent->velocity_ = defaultAgent_->velocity_;
+		}
+
+		return insertAgent(agent);
 	}
 
 	size_t RVOSimulator::addAgent(const Vector2 &position, float neighborDist, size_t maxNeighbors, float timeHorizon, float timeHorizonObst, float radius, float maxSpeed, const Vector2 &velocity)
 	{
+		/* Agents added in a row with the same properties share a profile. */
+		AgentProfile *profile = (agents_.empty() ? NULL : agents_.back()->profile_);
+
+		if (profile == NULL || !profile->isOverride_ || profile->maxNeighbors_ != maxNeighbors || profile->maxSpeed_ != maxSpeed || profile->neighborDist_ != neighborDist || profile->radius_ != radius || profile->timeHorizon_ != timeHorizon || profile->timeHorizonObst_ != timeHorizonObst) {
+			profile = profiles_[addAgentProfile(neighborDist, maxNeighbors, timeHorizon, timeHorizonObst, radius, maxSpeed)];
+			profile->isOverride_ = true;
+		}
+
 		Agent *agent = new Agent(this);
 
 		agent->position_ = position;
-		agent->maxNeighbors_ = maxNeighbors;
-		agent->maxSpeed_ = maxSpeed;
-		agent->neighborDist_ = neighborDist;
-		agent->radius_ = radius;
-		agent->timeHorizon_ = timeHorizon;
-		agent->timeHorizonObst_ = timeHorizonObst;
+		agent->profile_ = profile;
 		agent->velocity_ = velocity;
 
-		agent->id_ = agents_.size();
+		return insertAgent(agent);
+	}
 
-		agents_.push_back(agent);
+	size_t RVOSimulator::addAgentProfile(float neighborDist, size_t maxNeighbors, float timeHorizon, float timeHorizonObst, float radius, float maxSpeed)
+	{
+		/* Reuse an override that no agent uses any more, if any. Entries that were given out again in the meantime are skipped. */
+		while (!freeProfiles_.empty()) {
+			AgentProfile *const profile = profiles_[freeProfiles_.back()];
+			freeProfiles_.pop_back();
 
-		return agents_.size() - 1;
+			if (!profile->isOverride_ || profile->numAgents_ > 0) {
+				continue;
+			}
+
+			profile->isOverride_ = false;
+			setAgentProfileParameters(profile->id_, neighborDist, maxNeighbors, timeHorizon, timeHorizonObst, radius, maxSpeed);
+
+			return profile->id_;
+		}
+
+		AgentProfile *profile = new AgentProfile();
+
+		profile->maxNeighbors_ = maxNeighbors;
+		profile->maxSpeed_ = maxSpeed;
+		profile->neighborDist_ = neighborDist;
+		profile->radius_ = radius;
+		profile->timeHorizon_ = timeHorizon;
+		profile->timeHorizonObst_ = timeHorizonObst;
+
+		profile->id_ = profiles_.size();
+
+		profiles_.push_back(profile);
+
+		return profiles_.size() - 1;
 	}
 
 	size_t RVOSimulator::addObstacle(const std::vector<Vector2> &vertices)
@@ -162,24 +284,117 @@ namespace RVO {
 
 	void RVOSimulator::doStep()
 	{
-		kdTree_->buildAgentTree();
+		RVO_TRACE_SCOPE("doStep");
+
+		constraintCapturing_ = ConstraintCapture::beginStep(constraintCaptureStep_);
+		updateAgentTree();
 
+		if (workStealing_ && threadPool_ == NULL) {
+			threadPool_ = new ThreadPool(numThreads_);
+		}
+
+		/* Every thread counts into its own counters, which are summed when queried, and keeps its scratch lines between steps. */
 #ifdef _OPENMP
-#pragma omp parallel for
+		solverStats_.resize(workStealing_ ? threadPool_->getNumThreads() : static_cast<size_t>(omp_get_max_threads()));
+#else
+		solverStats_.resize(workStealing_ ? threadPool_->getNumThreads() : 1);
 #endif
-		for (int i = 0; i < static_cast<int>(agents_.size()); ++i) {
-			agents_[i]->computeNeighbors();
-			agents_[i]->computeNewVelocity();
+		projLines_.resize(solverStats_.size());
+
+		for (size_t i = 0; i < solverStats_.size(); ++i) {
+			solverStats_[i].stats = SolverStats();
 		}
 
+		if (workStealing_) {
+			/* Leaves and agents are in kd-tree order, so that chunks are spatially coherent. */
+			NewVelocityTask newVelocityTask(this, &solverStats_[0], &projLines_[0]);
+
+			if (neighborQueryBatching_) {
+				threadPool_->run(newVelocityTask, kdTree_->agentLeaves_.size(), 4);
+			}
+			else {
+				threadPool_->run(newVelocityTask, kdTree_->agents_.size(), 32);
+			}
+
+			UpdateTask updateTask(this);
+			threadPool_->run(updateTask, kdTree_->agents_.size(), 256);
+
+			kdTree_->agentPositionsValid_ = true;
+			agentTreeDirty_ = true;
+			globalTime_ += timeStep_;
+			++numSteps_;
+
+			return;
+		}
+
+		/* One parallel region, so that the threads are only forked and joined once per step. */
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+		{
+			/* The loops do not wait at their end, so that the trace events and counters of the threads leave out the barriers. */
+			RVO_TRACE_BEGIN(newVelocityScope, "computeNewVelocity");
+			PerfScope newVelocityPerfScope(PerfCounters::COMPUTE_NEW_VELOCITY);
+
+#ifdef _OPENMP
+			SolverStats &stats = solverStats_[omp_get_thread_num()].stats;
+			std::vector<Line> &projLines = projLines_[omp_get_thread_num()];
+#else
+			SolverStats &stats = solverStats_[0].stats;
+			std::vector<Line> &projLines = projLines_[0];
+#endif
+
+			if (neighborQueryBatching_) {
+				std::vector<std::pair<float, size_t> > leaves;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic) nowait
+#endif
+				for (int i = 0; i < static_cast<int>(kdTree_->agentLeaves_.size()); ++i) {
+					const size_t leaf = kdTree_->agentLeaves_[i];
+					kdTree_->computeLeafCandidates(leaf, leaves);
+
+					for (size_t j = kdTree_->agentTree_[leaf].begin; j < kdTree_->agentTree_[leaf].end; ++j) {
+						kdTree_->agents_[j]->computeNeighbors(leaves);
+						kdTree_->agents_[j]->computeNewVelocity(stats, projLines);
+					}
+				}
+			}
+			else {
+#ifdef _OPENMP
+#pragma omp for nowait
+#endif
+				for (int i = 0; i < static_cast<int>(agents_.size()); ++i) {
+					agents_[i]->computeNeighbors();
+					agents_[i]->computeNewVelocity(stats, projLines);
+				}
+			}
+
+			newVelocityPerfScope.end();
+			RVO_TRACE_END(newVelocityScope);
+
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
+
+			RVO_TRACE_BEGIN(updateScope, "updateAgents");
+			PerfScope updatePerfScope(PerfCounters::UPDATE_AGENTS);
+
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp for nowait
 #endif
-		for (int i = 0; i < static_cast<int>(agents_.size()); ++i) {
-			agents_[i]->update();
+			for (int i = 0; i < static_cast<int>(kdTree_->agents_.size()); ++i) {
+				updateAgents(i, i + 1);
+			}
+
+			updatePerfScope.end();
+			RVO_TRACE_END(updateScope);
 		}
 
+		kdTree_->agentPositionsValid_ = true;
+		agentTreeDirty_ = true;
 		globalTime_ += timeStep_;
+		++numSteps_;
 	}
 
 	size_t RVOSimulator::getAgentAgentNeighbor(size_t agentNo, size_t neighborNo) const
@@ -187,19 +402,37 @@ namespace RVO {
 		return agents_[agentNo]->agentNeighbors_[neighborNo].second->id_;
 	}
 
+	AgentHandle RVOSimulator::getAgentHandle(size_t agentNo) const
+	{
+		AgentHandle handle;
+		handle.slot = agents_[agentNo]->slot_;
+		handle.generation = slotGenerations_[handle.slot];
+
+		return handle;
+	}
+
 	size_t RVOSimulator::getAgentMaxNeighbors(size_t agentNo) const
 	{
-		return agents_[agentNo]->maxNeighbors_;
+		return agents_[agentNo]->profile_->maxNeighbors_;
 	}
 
 	float RVOSimulator::getAgentMaxSpeed(size_t agentNo) const
 	{
-		return agents_[agentNo]->maxSpeed_;
+		return agents_[agentNo]->profile_->maxSpeed_;
 	}
 
 	float RVOSimulator::getAgentNeighborDist(size_t agentNo) const
 	{
-		return agents_[agentNo]->neighborDist_;
+		return agents_[agentNo]->profile_->neighborDist_;
+	}
+
+	size_t RVOSimulator::getAgentNo(const AgentHandle &handle) const
+	{
+		if (handle.slot >= slotAgents_.size() || handle.generation != slotGenerations_[handle.slot]) {
+			return RVO_ERROR;
+		}
+
+		return slotAgents_[handle.slot];
 	}
 
 	size_t RVOSimulator::getAgentNumAgentNeighbors(size_t agentNo) const
@@ -237,19 +470,24 @@ namespace RVO {
 		return agents_[agentNo]->prefVelocity_;
 	}
 
+	size_t RVOSimulator::getAgentProfile(size_t agentNo) const
+	{
+		return agents_[agentNo]->profile_->id_;
+	}
+
 	float RVOSimulator::getAgentRadius(size_t agentNo) const
 	{
-		return agents_[agentNo]->radius_;
+		return agents_[agentNo]->profile_->radius_;
 	}
 
 	float RVOSimulator::getAgentTimeHorizon(size_t agentNo) const
 	{
-		return agents_[agentNo]->timeHorizon_;
+		return agents_[agentNo]->profile_->timeHorizon_;
 	}
 
 	float RVOSimulator::getAgentTimeHorizonObst(size_t agentNo) const
 	{
-		return agents_[agentNo]->timeHorizonObst_;
+		return agents_[agentNo]->profile_->timeHorizonObst_;
 	}
 
 	const Vector2 &RVOSimulator::getAgentVelocity(size_t agentNo) const
@@ -257,26 +495,117 @@ namespace RVO {
 		return agents_[agentNo]->velocity_;
 	}
 
+	size_t RVOSimulator::getDefaultAgentProfile() const
+	{
+		if (defaultAgent_ == NULL) {
+			return RVO_ERROR;
+		}
+
+		return defaultAgent_->profile_->id_;
+	}
+
 	float RVOSimulator::getGlobalTime() const
 	{
 		return globalTime_;
 	}
 
+	bool RVOSimulator::getLinearProgramRandomOrder() const
+	{
+		return linearProgramRandomOrder_;
+	}
+
+	bool RVOSimulator::getLinearProgramWarmStart() const
+	{
+		return linearProgramWarmStart_;
+	}
+
+	MemoryStats RVOSimulator::getMemoryStats() const
+	{
+		MemoryStats stats;
+
+		stats.agents = agents_.capacity() * sizeof(Agent *) + agents_.size() * sizeof(Agent);
+
+		for (size_t i = 0; i < agents_.size(); ++i) {
+			stats.agentNeighbors += agents_[i]->agentNeighbors_.capacity() * sizeof(agents_[i]->agentNeighbors_[0]);
+			stats.agentNeighbors += agents_[i]->tightNeighbors_.capacity() * sizeof(agents_[i]->tightNeighbors_[0]);
+			stats.obstacleNeighbors += agents_[i]->obstacleNeighbors_.capacity() * sizeof(agents_[i]->obstacleNeighbors_[0]);
+			stats.orcaLines += agents_[i]->orcaLines_.capacity() * sizeof(Line);
+		}
+
+		if (defaultAgent_ != NULL) {
+			stats.agents += sizeof(Agent);
+		}
+
+		stats.agentProfiles = profiles_.capacity() * sizeof(AgentProfile *) + freeProfiles_.capacity() * sizeof(size_t) + profiles_.size() * sizeof(AgentProfile);
+
+		stats.agentTree = sizeof(KdTree) + kdTree_->agents_.capacity() * sizeof(Agent *) + kdTree_->agentLeaves_.capacity() * sizeof(size_t) + kdTree_->agentTree_.capacity() * sizeof(KdTree::AgentTreeNode);
+		stats.obstacleTree = kdTree_->countObstacleTreeNodes(kdTree_->obstacleTree_) * sizeof(KdTree::ObstacleTreeNode);
+
+		stats.obstacles = obstacles_.capacity() * sizeof(Obstacle *) + (obstacles_.size() - numSplitObstacles_) * sizeof(Obstacle);
+		stats.splitObstacles = numSplitObstacles_ * sizeof(Obstacle);
+
+		stats.scratch = kdTree_->agentPositions_.capacity() * sizeof(Vector2) + solverStats_.capacity() * sizeof(ThreadSolverStats) + projLines_.capacity() * sizeof(std::vector<Line>);
+
+		for (size_t i = 0; i < projLines_.size(); ++i) {
+			stats.scratch += projLines_[i].capacity() * sizeof(Line);
+		}
+		stats.slots = (freeSlots_.capacity() + slotAgents_.capacity() + slotGenerations_.capacity()) * sizeof(size_t);
+
+		return stats;
+	}
+
 	size_t RVOSimulator::getNumAgents() const
 	{
 		return agents_.size();
 	}
 
+	size_t RVOSimulator::getNumAgentProfiles() const
+	{
+		return profiles_.size();
+	}
+
 	size_t RVOSimulator::getNumObstacleVertices() const
 	{
 		return obstacles_.size();
 	}
 
+	size_t RVOSimulator::getNumThreads() const
+	{
+		if (numThreads_ == 0) {
+			return std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		return numThreads_;
+	}
+
 	const Vector2 &RVOSimulator::getObstacleVertex(size_t vertexNo) const
 	{
 		return obstacles_[vertexNo]->point_;
 	}
 
+	SolverStats RVOSimulator::getSolverStats() const
+	{
+		SolverStats sum;
+
+		for (size_t i = 0; i < solverStats_.size(); ++i) {
+			const SolverStats &stats = solverStats_[i].stats;
+			sum.agentLines += stats.agentLines;
+			sum.agents += stats.agents;
+			sum.collidingAgents += stats.collidingAgents;
+			sum.coveredObstacles += stats.coveredObstacles;
+			sum.linearProgram1Calls += stats.linearProgram1Calls;
+			sum.linearProgram3Calls += stats.linearProgram3Calls;
+			sum.obstacleLines += stats.obstacleLines;
+		}
+
+		return sum;
+	}
+
+	bool RVOSimulator::getNeighborQueryBatching() const
+	{
+		return neighborQueryBatching_;
+	}
+
 	size_t RVOSimulator::getNextObstacleVertexNo(size_t vertexNo) const
 	{
 		return obstacles_[vertexNo]->nextObstacle_->id_;
@@ -292,49 +621,538 @@ namespace RVO {
 		return timeStep_;
 	}
 
+	bool RVOSimulator::getWorkStealing() const
+	{
+		return workStealing_;
+	}
+
+	bool RVOSimulator::loadState(const std::vector<char> &state)
+	{
+		size_t offset = 0;
+		unsigned int magic = 0;
+		unsigned int version = 0;
+		unsigned char wordSize = 0;
+		unsigned char hasDefaultAgent = 0;
+		unsigned char linearProgramRandomOrder = 0;
+		unsigned char linearProgramWarmStart = 0;
+		unsigned char neighborQueryBatching = 0;
+		float globalTime = 0.0f;
+		size_t numSteps = 0;
+		float timeStep = 0.0f;
+
+		bool valid = readState(state, offset, magic) && magic == RVO_STATE_MAGIC &&
+					 readState(state, offset, version) && version == RVO_STATE_VERSION &&
+					 readState(state, offset, wordSize) && wordSize == sizeof(size_t) &&
+					 readState(state, offset, hasDefaultAgent) &&
+					 readState(state, offset, linearProgramRandomOrder) &&
+					 readState(state, offset, linearProgramWarmStart) &&
+					 readState(state, offset, neighborQueryBatching) &&
+					 readState(state, offset, globalTime) &&
+					 readState(state, offset, numSteps) &&
+					 readState(state, offset, timeStep);
+
+		/* Everything is read into new objects first, so that an invalid state leaves the simulation unchanged. */
+		std::vector<AgentProfile *> profiles;
+		size_t numProfiles = 0;
+		valid = valid && readState(state, offset, numProfiles) && numProfiles <= state.size();
+
+		for (size_t i = 0; valid && i < numProfiles; ++i) {
+			AgentProfile *profile = new AgentProfile();
+			profile->id_ = i;
+			profiles.push_back(profile);
+
+			unsigned char isOverride = 0;
+			valid = readState(state, offset, isOverride) &&
+					readState(state, offset, profile->maxNeighbors_) &&
+					readState(state, offset, profile->maxSpeed_) &&
+					readState(state, offset, profile->neighborDist_) &&
+					readState(state, offset, profile->radius_) &&
+					readState(state, offset, profile->timeHorizon_) &&
+					readState(state, offset, profile->timeHorizonObst_);
+			profile->isOverride_ = (isOverride != 0);
+		}
+
+		Agent *defaultAgent = NULL;
+
+		if (valid && hasDefaultAgent) {
+			defaultAgent = new Agent(this);
+			valid = defaultAgent->loadState(state, offset, profiles);
+		}
+
+		std::vector<Agent *> agents;
+		size_t numAgents = 0;
+		valid = valid && readState(state, offset, numAgents) && numAgents <= state.size();
+
+		for (size_t i = 0; valid && i < numAgents; ++i) {
+			Agent *agent = new Agent(this);
+			agent->id_ = i;
+			agents.push_back(agent);
+			valid = agent->loadState(state, offset, profiles) &&
+					readState(state, offset, agent->slot_);
+
+			if (valid) {
+				++agent->profile_->numAgents_;
+			}
+		}
+
+		std::vector<size_t> slotAgents;
+		std::vector<size_t> slotGenerations;
+		size_t numSlots = 0;
+		valid = valid && readState(state, offset, numSlots) && numSlots <= state.size();
+
+		if (valid) {
+			slotAgents.resize(numSlots, RVO_ERROR);
+			slotGenerations.resize(numSlots);
+		}
+
+		for (size_t i = 0; valid && i < numSlots; ++i) {
+			valid = readState(state, offset, slotGenerations[i]);
+		}
+
+		for (size_t i = 0; valid && i < numAgents; ++i) {
+			valid = agents[i]->slot_ < numSlots && slotAgents[agents[i]->slot_] == RVO_ERROR;
+
+			if (valid) {
+				slotAgents[agents[i]->slot_] = i;
+			}
+		}
+
+		std::vector<size_t> freeSlots;
+		size_t numFreeSlots = 0;
+		valid = valid && readState(state, offset, numFreeSlots) && numFreeSlots <= numSlots;
+
+		if (valid) {
+			freeSlots.resize(numFreeSlots);
+		}
+
+		for (size_t i = 0; valid && i < numFreeSlots; ++i) {
+			valid = readState(state, offset, freeSlots[i]) && freeSlots[i] < numSlots && slotAgents[freeSlots[i]] == RVO_ERROR;
+		}
+
+		std::vector<Obstacle *> obstacles;
+		std::vector<size_t> nextObstacleNos;
+		std::vector<size_t> prevObstacleNos;
+		size_t numObstacles = 0;
+		size_t numSplitObstacles = 0;
+		valid = valid && readState(state, offset, numObstacles) && numObstacles <= state.size() &&
+				readState(state, offset, numSplitObstacles) && numSplitObstacles <= numObstacles;
+
+		for (size_t i = 0; valid && i < numObstacles; ++i) {
+			Obstacle *obstacle = new Obstacle();
+			obstacle->id_ = i;
+			obstacles.push_back(obstacle);
+
+			unsigned char isConvex = 0;
+			size_t nextObstacleNo = 0;
+			size_t prevObstacleNo = 0;
+			valid = readState(state, offset, isConvex) &&
+					readState(state, offset, obstacle->point_) &&
+					readState(state, offset, obstacle->unitDir_) &&
+					readState(state, offset, nextObstacleNo) && nextObstacleNo < numObstacles &&
+					readState(state, offset, prevObstacleNo) && prevObstacleNo < numObstacles;
+			obstacle->isConvex_ = (isConvex != 0);
+			nextObstacleNos.push_back(nextObstacleNo);
+			prevObstacleNos.push_back(prevObstacleNo);
+		}
+
+		for (size_t i = 0; valid && i < numObstacles; ++i) {
+			obstacles[i]->nextObstacle_ = obstacles[nextObstacleNos[i]];
+			obstacles[i]->prevObstacle_ = obstacles[prevObstacleNos[i]];
+		}
+
+		std::vector<size_t> nodes;
+		size_t numNodes = 0;
+		valid = valid && readState(state, offset, numNodes) && numNodes <= state.size();
+
+		if (valid) {
+			nodes.resize(numNodes);
+		}
+
+		for (size_t i = 0; valid && i < numNodes; ++i) {
+			valid = readState(state, offset, nodes[i]);
+		}
+
+		valid = valid && offset == state.size();
+
+		KdTree *kdTree = NULL;
+
+		if (valid) {
+			/* The obstacle tree refers to the obstacles of the simulation. */
+			kdTree = new KdTree(this);
+			obstacles_.swap(obstacles);
+
+			if (!kdTree->loadObstacleTree(nodes)) {
+				obstacles_.swap(obstacles);
+				delete kdTree;
+				kdTree = NULL;
+				valid = false;
+			}
+		}
+
+		if (valid) {
+			/* The replaced objects are deleted below. */
+			agents_.swap(agents);
+			freeSlots_.swap(freeSlots);
+			profiles_.swap(profiles);
+			freeProfiles_.clear();
+
+			for (size_t i = 0; i < profiles_.size(); ++i) {
+				if (profiles_[i]->isOverride_ && profiles_[i]->numAgents_ == 0) {
+					freeProfiles_.push_back(i);
+				}
+			}
+
+			slotAgents_.swap(slotAgents);
+			slotGenerations_.swap(slotGenerations);
+			std::swap(defaultAgent_, defaultAgent);
+			std::swap(kdTree_, kdTree);
+
+			agentTreeDirty_ = true;
+			globalTime_ = globalTime;
+			linearProgramRandomOrder_ = (linearProgramRandomOrder != 0);
+			linearProgramWarmStart_ = (linearProgramWarmStart != 0);
+			neighborQueryBatching_ = (neighborQueryBatching != 0);
+			numSplitObstacles_ = numSplitObstacles;
+			numSteps_ = numSteps;
+			timeStep_ = timeStep;
+		}
+
+		delete defaultAgent;
+		delete kdTree;
+
+		for (size_t i = 0; i < agents.size(); ++i) {
+			delete agents[i];
+		}
+
+		for (size_t i = 0; i < obstacles.size(); ++i) {
+			delete obstacles[i];
+		}
+
+		for (size_t i = 0; i < profiles.size(); ++i) {
+			delete profiles[i];
+		}
+
+		return valid;
+	}
+
+	bool RVOSimulator::loadState(const std::string &fileName)
+	{
+		std::ifstream file(fileName.c_str(), std::ios::binary);
+
+		if (!file) {
+			return false;
+		}
+
+		const std::vector<char> state((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		return !file.bad() && loadState(state);
+	}
+
 	void RVOSimulator::processObstacles()
 	{
 		kdTree_->buildObstacleTree();
 	}
 
+	void RVOSimulator::queryAgentsInRadius(const Vector2 &point, float radius, std::vector<size_t> &agentNos) const
+	{
+		updateAgentTree();
+
+		agentNos.clear();
+		kdTree_->queryAgentsInRadius(point, sqr(radius), agentNos);
+	}
+
+	void RVOSimulator::queryAgentsInRadius(const std::vector<Vector2> &points, float radius, std::vector<std::vector<size_t> > &agentNos) const
+	{
+		updateAgentTree();
+
+		agentNos.resize(points.size());
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+		for (int i = 0; i < static_cast<int>(points.size()); ++i) {
+			agentNos[i].clear();
+			kdTree_->queryAgentsInRadius(points[i], sqr(radius), agentNos[i]);
+		}
+	}
+
+	void RVOSimulator::queryAgentsInRect(const Vector2 &minCorner, const Vector2 &maxCorner, std::vector<size_t> &agentNos) const
+	{
+		updateAgentTree();
+
+		agentNos.clear();
+		kdTree_->queryAgentsInRect(minCorner, maxCorner, agentNos);
+	}
+
+	void RVOSimulator::queryAgentsInRect(const std::vector<Vector2> &minCorners, const std::vector<Vector2> &maxCorners, std::vector<std::vector<size_t> > &agentNos) const
+	{
+		updateAgentTree();
+
+		agentNos.resize(minCorners.size());
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+		for (int i = 0; i < static_cast<int>(minCorners.size()); ++i) {
+			agentNos[i].clear();
+			kdTree_->queryAgentsInRect(minCorners[i], maxCorners[i], agentNos[i]);
+		}
+	}
+
+	void RVOSimulator::queryNearestAgents(const Vector2 &point, size_t numAgents, std::vector<size_t> &agentNos, float maxDist) const
+	{
+		updateAgentTree();
+
+		std::vector<std::pair<float, size_t> > neighbors;
+		kdTree_->queryNearestAgents(point, numAgents, sqr(maxDist), neighbors);
+
+		agentNos.resize(neighbors.size());
+
+		for (size_t i = 0; i < neighbors.size(); ++i) {
+			agentNos[i] = neighbors[i].second;
+		}
+	}
+
+	void RVOSimulator::queryNearestAgents(const std::vector<Vector2> &points, size_t numAgents, std::vector<std::vector<size_t> > &agentNos, float maxDist) const
+	{
+		updateAgentTree();
+
+		agentNos.resize(points.size());
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+		{
+			std::vector<std::pair<float, size_t> > neighbors;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+			for (int i = 0; i < static_cast<int>(points.size()); ++i) {
+				neighbors.clear();
+				kdTree_->queryNearestAgents(points[i], numAgents, sqr(maxDist), neighbors);
+
+				agentNos[i].resize(neighbors.size());
+
+				for (size_t j = 0; j < neighbors.size(); ++j) {
+					agentNos[i][j] = neighbors[j].second;
+				}
+			}
+		}
+	}
+
+	float RVOSimulator::queryObstacleDistance(const Vector2 &point, float maxDist) const
+	{
+		float rangeSq = sqr(maxDist);
+		kdTree_->queryObstacleDistance(point, rangeSq);
+
+		return std::sqrt(rangeSq);
+	}
+
 	bool RVOSimulator::queryVisibility(const Vector2 &point1, const Vector2 &point2, float radius) const
 	{
 		return kdTree_->queryVisibility(point1, point2, radius);
 	}
 
+	void RVOSimulator::queryVisibility(const std::vector<Vector2> &points1, const std::vector<Vector2> &points2, std::vector<bool> &visible, float radius) const
+	{
+		const size_t BATCH_SIZE = 256;
+		const size_t numBatches = (points1.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+
+		std::vector<char> visibleBatch(points1.size());
+		std::vector<char> masks(points1.size());
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+		{
+			std::vector<size_t> queries;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+			for (int i = 0; i < static_cast<int>(numBatches); ++i) {
+				const size_t begin = i * BATCH_SIZE;
+				const size_t end = std::min(begin + BATCH_SIZE, points1.size());
+
+				kdTree_->queryVisibility(points1, points2, radius, begin, end, visibleBatch, masks, queries);
+			}
+		}
+
+		visible.assign(visibleBatch.begin(), visibleBatch.end());
+	}
+
+	bool RVOSimulator::raycastObstacles(const Vector2 &origin, const Vector2 &direction, float maxDistance, RaycastHit &hit) const
+	{
+		const Vector2 end = origin + maxDistance * normalize(direction);
+
+		float t;
+		const Obstacle *const obstacle = kdTree_->raycast(origin, end, t);
+
+		hit.point = origin + t * (end - origin);
+		hit.distance = t * maxDistance;
+		hit.obstacleNo = (obstacle != NULL ? obstacle->id_ : RVO_ERROR);
+
+		return obstacle != NULL;
+	}
+
+	void RVOSimulator::raycastObstacles(const std::vector<Vector2> &origins, const std::vector<Vector2> &directions, float maxDistance, std::vector<RaycastHit> &hits) const
+	{
+		hits.resize(origins.size());
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+		for (int i = 0; i < static_cast<int>(origins.size()); ++i) {
+			raycastObstacles(origins[i], directions[i], maxDistance, hits[i]);
+		}
+	}
+
+	void RVOSimulator::removeAgent(size_t agentNo)
+	{
+		Agent *const agent = agents_[agentNo];
+
+		releaseAgentProfile(agent->profile_);
+
+		/* Handles to the slot of the agent become stale. */
+		slotAgents_[agent->slot_] = RVO_ERROR;
+		++slotGenerations_[agent->slot_];
+		freeSlots_.push_back(agent->slot_);
+
+		/* The last agent takes the place of the removed agent. */
+		if (agentNo + 1 < agents_.size()) {
+			agents_[agentNo] = agents_.back();
+			agents_[agentNo]->id_ = agentNo;
+			slotAgents_[agents_[agentNo]->slot_] = agentNo;
+		}
+
+		agents_.pop_back();
+		delete agent;
+
+		/* The agent kd-tree gathers the remaining agents again on its next build. */
+		kdTree_->agents_.clear();
+		agentTreeDirty_ = true;
+	}
+
+	void RVOSimulator::saveState(std::vector<char> &state) const
+	{
+		state.clear();
+
+		writeState(state, RVO_STATE_MAGIC);
+		writeState(state, RVO_STATE_VERSION);
+		writeState(state, static_cast<unsigned char>(sizeof(size_t)));
+		writeState(state, static_cast<unsigned char>(defaultAgent_ != NULL));
+		writeState(state, static_cast<unsigned char>(linearProgramRandomOrder_));
+		writeState(state, static_cast<unsigned char>(linearProgramWarmStart_));
+		writeState(state, static_cast<unsigned char>(neighborQueryBatching_));
+		writeState(state, globalTime_);
+		writeState(state, numSteps_);
+		writeState(state, timeStep_);
+
+		writeState(state, profiles_.size());
+
+		for (size_t i = 0; i < profiles_.size(); ++i) {
+			writeState(state, static_cast<unsigned char>(profiles_[i]->isOverride_));
+			writeState(state, profiles_[i]->maxNeighbors_);
+			writeState(state, profiles_[i]->maxSpeed_);
+			writeState(state, profiles_[i]->neighborDist_);
+			writeState(state, profiles_[i]->radius_);
+			writeState(state, profiles_[i]->timeHorizon_);
+			writeState(state, profiles_[i]->timeHorizonObst_);
+		}
+
+		if (defaultAgent_ != NULL) {
+			defaultAgent_->saveState(state);
+		}
+
+		writeState(state, agents_.size());
+
+		for (size_t i = 0; i < agents_.size(); ++i) {
+			agents_[i]->saveState(state);
+			writeState(state, agents_[i]->slot_);
+		}
+
+		writeState(state, slotGenerations_.size());
+
+		for (size_t i = 0; i < slotGenerations_.size(); ++i) {
+			writeState(state, slotGenerations_[i]);
+		}
+
+		writeState(state, freeSlots_.size());
+
+		for (size_t i = 0; i < freeSlots_.size(); ++i) {
+			writeState(state, freeSlots_[i]);
+		}
+
+		/* Includes the obstacles that were split while building the obstacle tree. */
+		writeState(state, obstacles_.size());
+		writeState(state, numSplitObstacles_);
+
+		for (size_t i = 0; i < obstacles_.size(); ++i) {
+			writeState(state, static_cast<unsigned char>(obstacles_[i]->isConvex_));
+			writeState(state, obstacles_[i]->point_);
+			writeState(state, obstacles_[i]->unitDir_);
+			writeState(state, obstacles_[i]->nextObstacle_->id_);
+			writeState(state, obstacles_[i]->prevObstacle_->id_);
+		}
+
+		std::vector<size_t> nodes;
+		kdTree_->saveObstacleTree(nodes);
+		writeState(state, nodes.size());
+
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			writeState(state, nodes[i]);
+		}
+	}
+
+	bool RVOSimulator::saveState(const std::string &fileName) const
+	{
+		std::vector<char> state;
+		saveState(state);
+
+		std::ofstream file(fileName.c_str(), std::ios::binary);
+		file.write(&state[0], static_cast<std::streamsize>(state.size()));
+
+		return file.good();
+	}
+
 	void RVOSimulator::setAgentDefaults(float neighborDist, size_t maxNeighbors, float timeHorizon, float timeHorizonObst, float radius, float maxSpeed, const Vector2 &velocity)
 	{
 		if (defaultAgent_ == NULL) {
 			defaultAgent_ = new Agent(this);
 		}
 
-		defaultAgent_->maxNeighbors_ = maxNeighbors;
-		defaultAgent_->maxSpeed_ = maxSpeed;
-		defaultAgent_->neighborDist_ = neighborDist;
-		defaultAgent_->radius_ = radius;
-		defaultAgent_->timeHorizon_ = timeHorizon;
-		defaultAgent_->timeHorizonObst_ = timeHorizonObst;
+		/* Agents that were already added keep the previous defaults. */
+		if (defaultAgent_->profile_ == NULL || defaultAgent_->profile_->numAgents_ > 0) {
+			defaultAgent_->profile_ = profiles_[addAgentProfile(neighborDist, maxNeighbors, timeHorizon, timeHorizonObst, radius, maxSpeed)];
+		}
+		else {
+			setAgentProfileParameters(defaultAgent_->profile_->id_, neighborDist, maxNeighbors, timeHorizon, timeHorizonObst, radius, maxSpeed);
+		}
+
 		defaultAgent_->velocity_ = velocity;
 	}
 
 	void RVOSimulator::setAgentMaxNeighbors(size_t agentNo, size_t maxNeighbors)
 	{
-		agents_[agentNo]->maxNeighbors_ = maxNeighbors;
+		overrideAgentProfile(agentNo)->maxNeighbors_ = maxNeighbors;
 	}
 
 	void RVOSimulator::setAgentMaxSpeed(size_t agentNo, float maxSpeed)
 	{
-		agents_[agentNo]->maxSpeed_ = maxSpeed;
+		overrideAgentProfile(agentNo)->maxSpeed_ = maxSpeed;
 	}
 
 	void RVOSimulator::setAgentNeighborDist(size_t agentNo, float neighborDist)
 	{
-		agents_[agentNo]->neighborDist_ = neighborDist;
+		overrideAgentProfile(agentNo)->neighborDist_ = neighborDist;
 	}
 
 	void RVOSimulator::setAgentPosition(size_t agentNo, const Vector2 &position)
 	{
 		agents_[agentNo]->position_ = position;
+		kdTree_->agentPositionsValid_ = false;
+		agentTreeDirty_ = true;
 	}
 
 	void RVOSimulator::setAgentPrefVelocity(size_t agentNo, const Vector2 &prefVelocity)
@@ -342,19 +1160,39 @@ namespace RVO {
 		agents_[agentNo]->prefVelocity_ = prefVelocity;
 	}
 
+	void RVOSimulator::setAgentProfile(size_t agentNo, size_t profileNo)
+	{
+		AgentProfile *const profile = agents_[agentNo]->profile_;
+		agents_[agentNo]->profile_ = profiles_[profileNo];
+		++agents_[agentNo]->profile_->numAgents_;
+		releaseAgentProfile(profile);
+	}
+
+	void RVOSimulator::setAgentProfileParameters(size_t profileNo, float neighborDist, size_t maxNeighbors, float timeHorizon, float timeHorizonObst, float radius, float maxSpeed)
+	{
+		AgentProfile *const profile = profiles_[profileNo];
+
+		profile->maxNeighbors_ = maxNeighbors;
+		profile->maxSpeed_ = maxSpeed;
+		profile->neighborDist_ = neighborDist;
+		profile->radius_ = radius;
+		profile->timeHorizon_ = timeHorizon;
+		profile->timeHorizonObst_ = timeHorizonObst;
+	}
+
 	void RVOSimulator::setAgentRadius(size_t agentNo, float radius)
 	{
-		agents_[agentNo]->radius_ = radius;
+		overrideAgentProfile(agentNo)->radius_ = radius;
 	}
 
 	void RVOSimulator::setAgentTimeHorizon(size_t agentNo, float timeHorizon)
 	{
-		agents_[agentNo]->timeHorizon_ = timeHorizon;
+		overrideAgentProfile(agentNo)->timeHorizon_ = timeHorizon;
 	}
 
 	void RVOSimulator::setAgentTimeHorizonObst(size_t agentNo, float timeHorizonObst)
 	{
-		agents_[agentNo]->timeHorizonObst_ = timeHorizonObst;
+		overrideAgentProfile(agentNo)->timeHorizonObst_ = timeHorizonObst;
 	}
 
 	void RVOSimulator::setAgentVelocity(size_t agentNo, const Vector2 &velocity)
@@ -362,8 +1200,107 @@ namespace RVO {
 		agents_[agentNo]->velocity_ = velocity;
 	}
 
+	void RVOSimulator::setLinearProgramRandomOrder(bool randomOrder)
+	{
+		linearProgramRandomOrder_ = randomOrder;
+	}
+
+	void RVOSimulator::setLinearProgramWarmStart(bool warmStart)
+	{
+		linearProgramWarmStart_ = warmStart;
+	}
+
+	void RVOSimulator::setNeighborQueryBatching(bool batching)
+	{
+		neighborQueryBatching_ = batching;
+	}
+
+	void RVOSimulator::setNumThreads(size_t numThreads)
+	{
+		if (numThreads != numThreads_) {
+			numThreads_ = numThreads;
+			delete threadPool_;
+			threadPool_ = NULL;
+		}
+	}
+
 	void RVOSimulator::setTimeStep(float timeStep)
 	{
 		timeStep_ = timeStep;
 	}
+
+	void RVOSimulator::setWorkStealing(bool workStealing)
+	{
+		workStealing_ = workStealing;
+	}
+
+	size_t RVOSimulator::insertAgent(Agent *agent)
+	{
+		agent->id_ = agents_.size();
+		++agent->profile_->numAgents_;
+
+		/* Reuse the slot of a removed agent, if any. */
+		if (freeSlots_.empty()) {
+			agent->slot_ = slotAgents_.size();
+			slotAgents_.push_back(agent->id_);
+			slotGenerations_.push_back(0);
+		}
+		else {
+			agent->slot_ = freeSlots_.back();
+			freeSlots_.pop_back();
+			slotAgents_[agent->slot_] = agent->id_;
+		}
+
+		agents_.push_back(agent);
+		agentTreeDirty_ = true;
+
+		return agents_.size() - 1;
+	}
+
+	AgentProfile *RVOSimulator::overrideAgentProfile(size_t agentNo)
+	{
+		Agent *const agent = agents_[agentNo];
+		AgentProfile *profile = agent->profile_;
+
+		/* Copy the profile on the first override, so that the other agents sharing it are unaffected. */
+		if (!profile->isOverride_ || profile->numAgents_ > 1) {
+			releaseAgentProfile(profile);
+			profile = profiles_[addAgentProfile(profile->neighborDist_, profile->maxNeighbors_, profile->timeHorizon_, profile->timeHorizonObst_, profile->radius_, profile->maxSpeed_)];
+			profile->isOverride_ = true;
+			profile->numAgents_ = 1;
+			agent->profile_ = profile;
+		}
+
+		return profile;
+	}
+
+	void RVOSimulator::releaseAgentProfile(AgentProfile *profile)
+	{
+		--profile->numAgents_;
+
+		/* Overrides belong to their agents only, so they are free once no agent uses them. */
+		if (profile->isOverride_ && profile->numAgents_ == 0) {
+			freeProfiles_.push_back(profile->id_);
+		}
+	}
+
+	void RVOSimulator::updateAgents(size_t begin, size_t end) const
+	{
+		for (size_t i = begin; i < end; ++i) {
+			Agent *const agent = kdTree_->agents_[i];
+			agent->update();
+			kdTree_->agentPositions_[i] = agent->position_;
+		}
+	}
+
+	void RVOSimulator::updateAgentTree() const
+	{
+		if (agentTreeDirty_) {
+			RVO_TRACE_SCOPE("buildAgentTree");
+			PerfScope perfScope(PerfCounters::BUILD_AGENT_TREE);
+
+			kdTree_->buildAgentTree();
+			agentTreeDirty_ = false;
+		}
+	}
 }
@@ -40,6 +40,7 @@
 
 #include <cstddef>
 #include <limits>
+#include <string>
 #include <vector>
 
 #include "Vector2.h"
@@ -69,9 +70,184 @@ namespace RVO {
 		Vector2 direction;
 	};
 
+	/**
+	 * \brief      Defines the result of a ray cast against the obstacles.
+	 */
+	class RaycastHit {
+	public:
+		/**
+		 * \brief     The two-dimensional point where the ray hits an obstacle.
+		 */
+		Vector2 point;
+
+		/**
+		 * \brief     The distance along the ray to the hit point.
+		 */
+		float distance;
+
+		/**
+		 * \brief     The number of the first vertex of the obstacle edge that
+		 *            is hit, or RVO::RVO_ERROR when no obstacle is hit.
+		 */
+		size_t obstacleNo;
+	};
+
+	/**
+	 * \brief      Defines a handle to an agent that stays valid while agents
+	 *             are removed, whereas agent numbers of other agents may change.
+	 */
+	class AgentHandle {
+	public:
+		/**
+		 * \brief     The slot of the agent.
+		 */
+		size_t slot;
+
+		/**
+		 * \brief     The generation of the slot, which changes when the agent
+		 *            in the slot is removed.
+		 */
+		size_t generation;
+	};
+
+	/**
+	 * \brief      Defines counters of the work done by the ORCA solver during
+	 *             a simulation step.
+	 */
+	class SolverStats {
+	public:
+		/**
+		 * \brief      Constructs counters that are all zero.
+		 */
+		SolverStats() : agentLines(0), agents(0), collidingAgents(0), coveredObstacles(0), linearProgram1Calls(0), linearProgram3Calls(0), obstacleLines(0) { }
+
+		/**
+		 * \brief      The number of ORCA lines built for agent neighbors.
+		 */
+		unsigned long long agentLines;
+
+		/**
+		 * \brief      The number of agents whose new velocity was computed.
+		 */
+		unsigned long long agents;
+
+		/**
+		 * \brief      The number of agents that collide with at least one
+		 *             agent neighbor.
+		 */
+		unsigned long long collidingAgents;
+
+		/**
+		 * \brief      The number of obstacle neighbors skipped because the ORCA
+		 *             lines of previous obstacles already covered them.
+		 */
+		unsigned long long coveredObstacles;
+
+		/**
+		 * \brief      The number of one-dimensional linear programs solved,
+		 *             including those of linearProgram3.
+		 */
+		unsigned long long linearProgram1Calls;
+
+		/**
+		 * \brief      The number of agents for which the two-dimensional linear
+		 *             program was infeasible, falling back to linearProgram3.
+		 */
+		unsigned long long linearProgram3Calls;
+
+		/**
+		 * \brief      The number of ORCA lines built for obstacle neighbors.
+		 */
+		unsigned long long obstacleLines;
+	};
+
+	/**
+	 * \brief      Defines the bytes of memory used by the parts of a
+	 *             simulation, excluding the overhead of the allocator.
+	 */
+	class MemoryStats {
+	public:
+		/**
+		 * \brief      Constructs statistics that are all zero.
+		 */
+		MemoryStats() : agentNeighbors(0), agentProfiles(0), agentTree(0), agents(0), obstacleNeighbors(0), obstacleTree(0), obstacles(0), orcaLines(0), scratch(0), slots(0), splitObstacles(0) { }
+
+		/**
+		 * \brief      Returns the bytes used by all parts.
+		 * \return     The sum of all parts.
+		 */
+		size_t getTotal() const
+		{
+			return agentNeighbors + agentProfiles + agentTree + agents + obstacleNeighbors + obstacleTree + obstacles + orcaLines + scratch + slots + splitObstacles;
+		}
+
+		/**
+		 * \brief      The capacity of the agent neighbor lists of the agents.
+		 */
+		size_t agentNeighbors;
+
+		/**
+		 * \brief      The agent profiles.
+		 */
+		size_t agentProfiles;
+
+		/**
+		 * \brief      The nodes, leaves and agent order of the agent
+		 *             <i>k</i>d-tree.
+		 */
+		size_t agentTree;
+
+		/**
+		 * \brief      The agents and the list of agents, without their vectors.
+		 */
+		size_t agents;
+
+		/**
+		 * \brief      The capacity of the obstacle neighbor lists of the agents.
+		 */
+		size_t obstacleNeighbors;
+
+		/**
+		 * \brief      The nodes of the obstacle <i>k</i>d-tree.
+		 */
+		size_t obstacleTree;
+
+		/**
+		 * \brief      The obstacle vertices that were added and the list of
+		 *             all obstacle vertices.
+		 */
+		size_t obstacles;
+
+		/**
+		 * \brief      The capacity of the ORCA line lists of the agents.
+		 */
+		size_t orcaLines;
+
+		/**
+		 * \brief      The buffers reused between steps, such as the gathered
+		 *             agent positions and the solver counters and scratch lines
+		 *             of the threads.
+		 */
+		size_t scratch;
+
+		/**
+		 * \brief      The tables that map agent handles to agents.
+		 */
+		size_t slots;
+
+		/**
+		 * \brief      The obstacle vertices created by splitting obstacles while
+		 *             building the obstacle <i>k</i>d-tree.
+		 */
+		size_t splitObstacles;
+	};
+
 	class Agent;
+	class AgentProfile;
+	class ConstraintCapture;
 	class KdTree;
 	class Obstacle;
+	class ThreadPool;
 
 	/**
 	 * \brief      Defines the simulation.
@@ -191,6 +367,45 @@ namespace RVO {
 						float timeHorizonObst, float radius, float maxSpeed,
 						const Vector2 &velocity = Vector2());
 
+		/**
+		 * \brief      Adds a new agent with the properties of a specified
+		 *             agent profile to the simulation.
+		 * \param      position        The two-dimensional starting position of
+		 *                             this agent.
+		 * \param      profileNo       The number of the agent profile.
+		 * \return     The number of the agent, or RVO::RVO_ERROR when the agent
+		 *             profile does not exist.
+		 */
+		size_t addAgent(const Vector2 &position, size_t profileNo);
+
+		/**
+		 * \brief      Adds a new agent profile to the simulation. The agents
+		 *             referencing a profile share its properties, and changing
+		 *             the profile changes them for all of these agents at once.
+		 *             Setting a property of a single agent gives that agent a
+		 *             copy of its profile.
+		 * \param      neighborDist    The maximum distance (center point to
+		 *                             center point) to other agents an agent
+		 *                             takes into account in the navigation.
+		 *                             Must be non-negative.
+		 * \param      maxNeighbors    The maximum number of other agents an
+		 *                             agent takes into account in the navigation.
+		 * \param      timeHorizon     The minimal amount of time for which an
+		 *                             agent's velocities are safe with respect to
+		 *                             other agents. Must be positive.
+		 * \param      timeHorizonObst The minimal amount of time for which an
+		 *                             agent's velocities are safe with respect to
+		 *                             obstacles. Must be positive.
+		 * \param      radius          The radius of an agent.
+		 *                             Must be non-negative.
+		 * \param      maxSpeed        The maximum speed of an agent.
+		 *                             Must be non-negative.
+		 * \return     The number of the agent profile.
+		 */
+		size_t addAgentProfile(float neighborDist, size_t maxNeighbors,
+							   float timeHorizon, float timeHorizonObst,
+							   float radius, float maxSpeed);
+
 		/**
 		 * \brief      Adds a new obstacle to the simulation.
 		 * \param      vertices        List of the vertices of the polygonal
@@ -221,6 +436,14 @@ namespace RVO {
 		 */
 		size_t getAgentAgentNeighbor(size_t agentNo, size_t neighborNo) const;
 
+		/**
+		 * \brief      Returns a handle to a specified agent.
+		 * \param      agentNo         The number of the agent whose handle is
+		 *                             to be retrieved.
+		 * \return     The handle to the agent.
+		 */
+		AgentHandle getAgentHandle(size_t agentNo) const;
+
 		/**
 		 * \brief      Returns the maximum neighbor count of a specified agent.
 		 * \param      agentNo         The number of the agent whose maximum
@@ -246,6 +469,14 @@ namespace RVO {
 		 */
 		float getAgentNeighborDist(size_t agentNo) const;
 
+		/**
+		 * \brief      Returns the number of the agent of a specified handle.
+		 * \param      handle          The handle to the agent.
+		 * \return     The number of the agent, or RVO::RVO_ERROR when the agent
+		 *             has been removed.
+		 */
+		size_t getAgentNo(const AgentHandle &handle) const;
+
 		/**
 		 * \brief      Returns the count of agent neighbors taken into account to
 		 *             compute the current velocity for the specified agent.
@@ -323,6 +554,14 @@ namespace RVO {
 		 */
 		const Vector2 &getAgentPrefVelocity(size_t agentNo) const;
 
+		/**
+		 * \brief      Returns the agent profile of a specified agent.
+		 * \param      agentNo         The number of the agent whose agent
+		 *                             profile is to be retrieved.
+		 * \return     The number of the agent profile of the agent.
+		 */
+		size_t getAgentProfile(size_t agentNo) const;
+
 		/**
 		 * \brief      Returns the radius of a specified agent.
 		 * \param      agentNo         The number of the agent whose radius is to
@@ -360,24 +599,69 @@ namespace RVO {
 		 */
 		const Vector2 &getAgentVelocity(size_t agentNo) const;
 
+		/**
+		 * \brief      Returns the agent profile of agents added with default
+		 *             properties.
+		 * \return     The number of the default agent profile, or
+		 *             RVO::RVO_ERROR when the agent defaults have not been set.
+		 */
+		size_t getDefaultAgentProfile() const;
+
 		/**
 		 * \brief      Returns the global time of the simulation.
 		 * \return     The present global time of the simulation (zero initially).
 		 */
 		float getGlobalTime() const;
 
+		/**
+		 * \brief      Returns whether the linear programs of the agents test
+		 *             their agent constraints in random order.
+		 * \return     True if the agent lines are shuffled.
+		 */
+		bool getLinearProgramRandomOrder() const;
+
+		/**
+		 * \brief      Returns whether the linear programs of the agents test
+		 *             the constraints that were tight in the previous step
+		 *             first.
+		 * \return     True if the linear programs are warm started.
+		 */
+		bool getLinearProgramWarmStart() const;
+
+		/**
+		 * \brief      Returns the bytes of memory used by the parts of the
+		 *             simulation.
+		 * \return     The memory used by the agents, trees, obstacles and
+		 *             buffers of the simulation.
+		 */
+		MemoryStats getMemoryStats() const;
+
 		/**
 		 * \brief      Returns the count of agents in the simulation.
 		 * \return     The count of agents in the simulation.
 		 */
 		size_t getNumAgents() const;
 
+		/**
+		 * \brief      Returns the count of agent profiles in the simulation.
+		 * \return     The count of agent profiles in the simulation.
+		 */
+		size_t getNumAgentProfiles() const;
+
 		/**
 		 * \brief      Returns the count of obstacle vertices in the simulation.
 		 * \return     The count of obstacle vertices in the simulation.
 		 */
 		size_t getNumObstacleVertices() const;
 
+		/**
+		 * \brief      Returns the number of threads used when work stealing is
+		 *             enabled.
+		 * \return     The number of threads, including the thread calling
+		 *             doStep.
+		 */
+		size_t getNumThreads() const;
+
 		/**
 		 * \brief      Returns the two-dimensional position of a specified obstacle
 		 *             vertex.
@@ -388,6 +672,20 @@ namespace RVO {
 		 */
 		const Vector2 &getObstacleVertex(size_t vertexNo) const;
 
+		/**
+		 * \brief      Returns the counters of the ORCA solver summed over the
+		 *             threads of the last simulation step.
+		 * \return     The counters of the last simulation step.
+		 */
+		SolverStats getSolverStats() const;
+
+		/**
+		 * \brief      Returns whether the agent neighbors are computed leaf by
+		 *             leaf of the agent <i>k</i>d-tree.
+		 * \return     True if the agent neighbor queries are batched per leaf.
+		 */
+		bool getNeighborQueryBatching() const;
+
 		/**
 		 * \brief      Returns the number of the obstacle vertex succeeding the
 		 *             specified obstacle vertex in its polygon.
@@ -414,6 +712,31 @@ namespace RVO {
 		 */
 		float getTimeStep() const;
 
+		/**
+		 * \brief      Returns whether doStep distributes the agents over its
+		 *             own work-stealing thread pool instead of OpenMP.
+		 * \return     True if work stealing is enabled.
+		 */
+		bool getWorkStealing() const;
+
+		/**
+		 * \brief      Restores the simulation from a state previously returned
+		 *             by saveState, replacing all agents and obstacles.
+		 * \param      state           The serialized state.
+		 * \return     True if the state was restored. The simulation is left
+		 *             unchanged when the state is invalid or was saved by an
+		 *             incompatible build.
+		 */
+		bool loadState(const std::vector<char> &state);
+
+		/**
+		 * \brief      Restores the simulation from a state file previously
+		 *             written by saveState.
+		 * \param      fileName        The name of the state file.
+		 * \return     True if the state was restored.
+		 */
+		bool loadState(const std::string &fileName);
+
 		/**
 		 * \brief      Processes the obstacles that have been added so that they
 		 *             are accounted for in the simulation.
@@ -422,6 +745,107 @@ namespace RVO {
 		 */
 		void processObstacles();
 
+		/**
+		 * \brief      Returns the agents whose center lies within the specified
+		 *             distance of the specified point.
+		 * \param      point           The two-dimensional center of the query.
+		 * \param      radius          The radius of the query. Must be
+		 *                             non-negative.
+		 * \param      agentNos        The numbers of the agents found, in no
+		 *                             particular order.
+		 * \note       The agent <i>k</i>d-tree is rebuilt by the first query
+		 *             after the agent positions have changed. Queries must
+		 *             therefore not be issued concurrently from several
+		 *             threads; use the batch version instead.
+		 */
+		void queryAgentsInRadius(const Vector2 &point, float radius,
+								 std::vector<size_t> &agentNos) const;
+
+		/**
+		 * \brief      Returns the agents whose center lies within the specified
+		 *             distance of each of the specified points, processing the
+		 *             queries in parallel.
+		 * \param      points          The two-dimensional centers of the
+		 *                             queries.
+		 * \param      radius          The radius of the queries. Must be
+		 *                             non-negative.
+		 * \param      agentNos        The numbers of the agents found for each
+		 *                             query, in no particular order.
+		 */
+		void queryAgentsInRadius(const std::vector<Vector2> &points,
+								 float radius,
+								 std::vector<std::vector<size_t> > &agentNos) const;
+
+		/**
+		 * \brief      Returns the agents whose center lies within the specified
+		 *             axis-aligned rectangle.
+		 * \param      minCorner       The corner of the rectangle with the
+		 *                             minimum coordinates.
+		 * \param      maxCorner       The corner of the rectangle with the
+		 *                             maximum coordinates.
+		 * \param      agentNos        The numbers of the agents found, in no
+		 *                             particular order.
+		 */
+		void queryAgentsInRect(const Vector2 &minCorner,
+							   const Vector2 &maxCorner,
+							   std::vector<size_t> &agentNos) const;
+
+		/**
+		 * \brief      Returns the agents whose center lies within each of the
+		 *             specified axis-aligned rectangles, processing the queries
+		 *             in parallel.
+		 * \param      minCorners      The corners of the rectangles with the
+		 *                             minimum coordinates.
+		 * \param      maxCorners      The corners of the rectangles with the
+		 *                             maximum coordinates.
+		 * \param      agentNos        The numbers of the agents found for each
+		 *                             query, in no particular order.
+		 */
+		void queryAgentsInRect(const std::vector<Vector2> &minCorners,
+							   const std::vector<Vector2> &maxCorners,
+							   std::vector<std::vector<size_t> > &agentNos) const;
+
+		/**
+		 * \brief      Returns the agents nearest to the specified point.
+		 * \param      point           The two-dimensional point of the query.
+		 * \param      numAgents       The maximum number of agents to return.
+		 * \param      agentNos        The numbers of the agents found, sorted
+		 *                             by increasing distance.
+		 * \param      maxDist         The maximum distance (center point to
+		 *                             center point) of the agents to return
+		 *                             (optional).
+		 */
+		void queryNearestAgents(const Vector2 &point, size_t numAgents,
+								std::vector<size_t> &agentNos,
+								float maxDist = std::numeric_limits<float>::infinity()) const;
+
+		/**
+		 * \brief      Returns the agents nearest to each of the specified
+		 *             points, processing the queries in parallel.
+		 * \param      points          The two-dimensional points of the queries.
+		 * \param      numAgents       The maximum number of agents to return
+		 *                             per query.
+		 * \param      agentNos        The numbers of the agents found for each
+		 *                             query, sorted by increasing distance.
+		 * \param      maxDist         The maximum distance (center point to
+		 *                             center point) of the agents to return
+		 *                             (optional).
+		 */
+		void queryNearestAgents(const std::vector<Vector2> &points,
+								size_t numAgents,
+								std::vector<std::vector<size_t> > &agentNos,
+								float maxDist = std::numeric_limits<float>::infinity()) const;
+
+		/**
+		 * \brief      Returns the distance from the specified point to the
+		 *             nearest edge of the processed obstacles.
+		 * \param      point           The two-dimensional point of the query.
+		 * \param      maxDist         The maximum distance to search.
+		 * \return     The distance to the nearest obstacle edge, or maxDist when
+		 *             no obstacle edge is nearer.
+		 */
+		float queryObstacleDistance(const Vector2 &point, float maxDist) const;
+
 		/**
 		 * \brief      Performs a visibility query between the two specified
 		 *             points with respect to the obstacles
@@ -438,6 +862,96 @@ namespace RVO {
 		bool queryVisibility(const Vector2 &point1, const Vector2 &point2,
 							 float radius = 0.0f) const;
 
+		/**
+		 * \brief      Performs visibility queries between several pairs of
+		 *             points with respect to the obstacles, processing the
+		 *             pairs in parallel batches that share a single traversal
+		 *             of the obstacle <i>k</i>d-tree.
+		 * \param      points1         The first points of the pairs.
+		 * \param      points2         The second points of the pairs. Must have
+		 *                             the same size as points1.
+		 * \param      visible         Whether the points of each pair are
+		 *                             mutually visible. All pairs are visible
+		 *                             when the obstacles have not been processed.
+		 * \param      radius          The minimal distance between the lines
+		 *                             connecting the points and the obstacles in
+		 *                             order for the points to be mutually visible
+		 *                             (optional). Must be non-negative.
+		 * \note       Pairs sharing a point or lying close together share more
+		 *             of the traversal, so it pays to order the pairs
+		 *             spatially.
+		 */
+		void queryVisibility(const std::vector<Vector2> &points1,
+							 const std::vector<Vector2> &points2,
+							 std::vector<bool> &visible,
+							 float radius = 0.0f) const;
+
+		/**
+		 * \brief      Casts a ray against the processed obstacles.
+		 * \param      origin          The two-dimensional origin of the ray.
+		 * \param      direction       The two-dimensional direction of the ray.
+		 *                             Need not be normalized. Must be non-zero.
+		 * \param      maxDistance     The maximum distance along the ray.
+		 *                             Must be positive and finite.
+		 * \param      hit             The nearest hit along the ray, if any.
+		 * \return     True if the ray hits an obstacle edge within the maximum
+		 *             distance. Returns false when the obstacles have not been
+		 *             processed.
+		 */
+		bool raycastObstacles(const Vector2 &origin, const Vector2 &direction,
+							  float maxDistance, RaycastHit &hit) const;
+
+		/**
+		 * \brief      Casts rays against the processed obstacles, processing the
+		 *             rays in parallel.
+		 * \param      origins         The two-dimensional origins of the rays.
+		 * \param      directions      The two-dimensional directions of the
+		 *                             rays. Need not be normalized. Must be
+		 *                             non-zero.
+		 * \param      maxDistance     The maximum distance along the rays.
+		 *                             Must be positive and finite.
+		 * \param      hits            The nearest hit along each ray. The
+		 *                             obstacle number of a hit is RVO::RVO_ERROR
+		 *                             when the ray does not hit an obstacle.
+		 */
+		void raycastObstacles(const std::vector<Vector2> &origins,
+							  const std::vector<Vector2> &directions,
+							  float maxDistance,
+							  std::vector<RaycastHit> &hits) const;
+
+		/**
+		 * \brief      Removes a specified agent from the simulation. The last
+		 *             agent takes over the number of the removed agent.
+		 * \param      agentNo         The number of the agent to be removed.
+		 * \note       The agent neighbors of the other agents are invalid until
+		 *             the next simulation step.
+		 * \note       A profile that the agent got by an explicit parameter or
+		 *             a property setter is reused for later profiles once no
+		 *             agent uses it, so that adding and removing agents keeps
+		 *             the number of profiles bounded.
+		 */
+		void removeAgent(size_t agentNo);
+
+		/**
+		 * \brief      Serializes the complete state of the simulation: the
+		 *             global time, the time step, the agent defaults, all agents
+		 *             and all obstacles, including the processed obstacle
+		 *             <i>k</i>d-tree, so that loadState does not need to
+		 *             process the obstacles again.
+		 * \param      state           The serialized state. Uses the native
+		 *                             byte order and word size.
+		 * \note       Neighbors and ORCA lines are recomputed by the next call
+		 *             to doStep and are not part of the state.
+		 */
+		void saveState(std::vector<char> &state) const;
+
+		/**
+		 * \brief      Writes the complete state of the simulation to a file.
+		 * \param      fileName        The name of the state file.
+		 * \return     True if the file was written.
+		 */
+		bool saveState(const std::string &fileName) const;
+
 		/**
 		 * \brief      Sets the default properties for any new agent that is
 		 *             added.
@@ -528,6 +1042,37 @@ namespace RVO {
 		 */
 		void setAgentPrefVelocity(size_t agentNo, const Vector2 &prefVelocity);
 
+		/**
+		 * \brief      Sets the agent profile of a specified agent.
+		 * \param      agentNo         The number of the agent whose agent
+		 *                             profile is to be modified.
+		 * \param      profileNo       The number of the replacement agent
+		 *                             profile.
+		 */
+		void setAgentProfile(size_t agentNo, size_t profileNo);
+
+		/**
+		 * \brief      Sets the properties of a specified agent profile, and
+		 *             thereby of all agents referencing it.
+		 * \param      profileNo       The number of the agent profile whose
+		 *                             properties are to be modified.
+		 * \param      neighborDist    The replacement maximum neighbor distance.
+		 *                             Must be non-negative.
+		 * \param      maxNeighbors    The replacement maximum neighbor count.
+		 * \param      timeHorizon     The replacement time horizon with respect
+		 *                             to other agents. Must be positive.
+		 * \param      timeHorizonObst The replacement time horizon with respect
+		 *                             to obstacles. Must be positive.
+		 * \param      radius          The replacement radius.
+		 *                             Must be non-negative.
+		 * \param      maxSpeed        The replacement maximum speed.
+		 *                             Must be non-negative.
+		 */
+		void setAgentProfileParameters(size_t profileNo, float neighborDist,
+									   size_t maxNeighbors, float timeHorizon,
+									   float timeHorizonObst, float radius,
+									   float maxSpeed);
+
 		/**
 		 * \brief      Sets the radius of a specified agent.
 		 * \param      agentNo         The number of the agent whose radius is to
@@ -568,6 +1113,73 @@ namespace RVO {
 		 */
 		void setAgentVelocity(size_t agentNo, const Vector2 &velocity);
 
+		/**
+		 * \brief      Sets whether the linear programs of the agents test their
+		 *             agent constraints in random order.
+		 * \param      randomOrder     If true, the agent neighbors and their
+		 *                             ORCA lines are shuffled before the linear
+		 *                             program, with a generator seeded by the
+		 *                             agent's slot and the step number, so that
+		 *                             every step takes a new order and runs are
+		 *                             reproducible.
+		 *                             In the incremental linear program, the
+		 *                             expected number of one-dimensional linear
+		 *                             programs is then linear in the number of
+		 *                             lines for any input, while the order of
+		 *                             distance may need quadratically many in
+		 *                             dense crossing flows. Obstacle lines and
+		 *                             the tight lines of a warm start stay in
+		 *                             front. As for the warm start, feasible
+		 *                             linear programs give the same new
+		 *                             velocities up to rounding, while the
+		 *                             fallback for infeasible ones depends on
+		 *                             the order of the lines. The agent
+		 *                             neighbors are reported in the shuffled
+		 *                             order.
+		 */
+		void setLinearProgramRandomOrder(bool randomOrder);
+
+		/**
+		 * \brief      Sets whether the linear programs of the agents test the
+		 *             constraints that were tight in the previous step first.
+		 * \param      warmStart       If true, the ORCA lines of the agent
+		 *                             neighbors whose lines were tight in the
+		 *                             previous step come first among the agent
+		 *                             lines. The same neighbors usually bind
+		 *                             again, so that fewer lines are violated
+		 *                             later and fewer one-dimensional linear
+		 *                             programs are solved. The obstacle lines
+		 *                             still come first. When the constraints are
+		 *                             feasible, the new velocity is the same up
+		 *                             to rounding, since it is the unique
+		 *                             velocity closest to the preferred one. The
+		 *                             fallback of linearProgram3 for infeasible
+		 *                             constraints depends on the order of the
+		 *                             lines and may differ. The agent neighbors
+		 *                             are reported in the reordered order.
+		 */
+		void setLinearProgramWarmStart(bool warmStart);
+
+		/**
+		 * \brief      Sets whether the agent neighbors are computed leaf by leaf
+		 *             of the agent <i>k</i>d-tree.
+		 * \param      batching        If true, the agents in a leaf share a
+		 *                             single traversal of the <i>k</i>d-tree that
+		 *                             collects the nearby leaves, which are then
+		 *                             refined per agent. The resulting neighbors
+		 *                             are the same as for separate queries.
+		 */
+		void setNeighborQueryBatching(bool batching);
+
+		/**
+		 * \brief      Sets the number of threads used when work stealing is
+		 *             enabled.
+		 * \param      numThreads      The number of threads, including the
+		 *                             thread calling doStep, or zero for the
+		 *                             number of hardware threads.
+		 */
+		void setNumThreads(size_t numThreads);
+
 		/**
 		 * \brief      Sets the time step of the simulation.
 		 * \param      timeStep        The time step of the simulation.
@@ -575,15 +1187,68 @@ namespace RVO {
 		 */
 		void setTimeStep(float timeStep);
 
+		/**
+		 * \brief      Sets whether doStep distributes the agents over its own
+		 *             work-stealing thread pool instead of OpenMP.
+		 * \param      workStealing    If true, the agents are processed in
+		 *                             <i>k</i>d-tree leaf order by a persistent
+		 *                             pool of threads that take chunks of
+		 *                             decreasing size and steal work from each
+		 *                             other, which balances scenes where the
+		 *                             cost per agent varies with the density.
+		 *                             Otherwise the agents are divided evenly
+		 *                             between the OpenMP threads, if any.
+		 */
+		void setWorkStealing(bool workStealing);
+
 	private:
+		class NewVelocityTask;
+		class UpdateTask;
+
+		/* Counters of one thread, on cache lines of their own. */
+		class ThreadSolverStats {
+		public:
+			SolverStats stats;
+			char padding[128 - sizeof(SolverStats)];
+		};
+
+		size_t insertAgent(Agent *agent);
+
+		AgentProfile *overrideAgentProfile(size_t agentNo);
+
+		void releaseAgentProfile(AgentProfile *profile);
+
+		void updateAgents(size_t begin, size_t end) const;
+
+		void updateAgentTree() const;
+
 		std::vector<Agent *> agents_;
+		mutable bool agentTreeDirty_;
+		size_t constraintCaptureStep_;
+		bool constraintCapturing_;
 		Agent *defaultAgent_;
 		float globalTime_;
 		KdTree *kdTree_;
+		bool linearProgramRandomOrder_;
+		bool linearProgramWarmStart_;
+		std::vector<size_t> freeProfiles_;
+		std::vector<size_t> freeSlots_;
+		bool neighborQueryBatching_;
+		size_t numSplitObstacles_;
+		size_t numSteps_;
+		size_t numThreads_;
 		std::vector<Obstacle *> obstacles_;
+		std::vector<AgentProfile *> profiles_;
+		std::vector<std::vector<Line> > projLines_;
+		std::vector<size_t> slotAgents_;
+		std::vector<size_t> slotGenerations_;
+		std::vector<ThreadSolverStats> solverStats_;
+		ThreadPool *threadPool_;
 		float timeStep_;
+		bool workStealing_;
 
 		friend class Agent;
+		friend class ConstraintCapture;
 		friend class KdTree;
 		friend class Obstacle;
 	};
@@ -0,0 +1,210 @@
+/*
+ * ThreadPool.cpp
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ThreadPool.h"
+
+#include "Trace.h"
+
+#include <algorithm>
+
+namespace RVO {
+	namespace {
+		inline unsigned long long packRange(size_t begin, size_t end)
+		{
+			return (static_cast<unsigned long long>(begin) << 32) | static_cast<unsigned long long>(end);
+		}
+
+		inline void unpackRange(unsigned long long items, size_t &begin, size_t &end)
+		{
+			begin = static_cast<size_t>(items >> 32);
+			end = static_cast<size_t>(items & 0xffffffffull);
+		}
+	}
+
+	ThreadPool::ThreadPool(size_t numThreads) : generation_(0), minChunkSize_(1), numBusyThreads_(0), numThreads_(numThreads), ranges_(NULL), stopping_(false), task_(NULL)
+	{
+		if (numThreads_ == 0) {
+			numThreads_ = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		ranges_ = new Range[numThreads_];
+
+		for (size_t i = 0; i < numThreads_; ++i) {
+			ranges_[i].items.store(0);
+		}
+
+		/* The thread calling run is thread zero. */
+		for (size_t i = 1; i < numThreads_; ++i) {
+			threads_.push_back(std::thread(&ThreadPool::runWorker, this, i));
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+
+		startCondition_.notify_all();
+
+		for (size_t i = 0; i < threads_.size(); ++i) {
+			threads_[i].join();
+		}
+
+		delete[] ranges_;
+	}
+
+	size_t ThreadPool::getNumThreads() const
+	{
+		return numThreads_;
+	}
+
+	void ThreadPool::run(Task &task, size_t numItems, size_t minChunkSize)
+	{
+		if (numItems == 0) {
+			return;
+		}
+
+		if (numThreads_ == 1 || numItems <= minChunkSize) {
+			task.run(0, numItems, 0);
+			return;
+		}
+
+		for (size_t i = 0; i < numThreads_; ++i) {
+			ranges_[i].items.store(packRange(numItems * i / numThreads_, numItems * (i + 1) / numThreads_), std::memory_order_relaxed);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			task_ = &task;
+			minChunkSize_ = std::max<size_t>(minChunkSize, 1);
+			numBusyThreads_ = threads_.size();
+			++generation_;
+		}
+
+		startCondition_.notify_all();
+
+		work(0);
+
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		while (numBusyThreads_ > 0) {
+			doneCondition_.wait(lock);
+		}
+
+		task_ = NULL;
+	}
+
+	void ThreadPool::runWorker(size_t threadNo)
+	{
+#if RVO_TRACING
+		Trace::setThreadName("RVO worker");
+#endif
+
+		size_t generation = 0;
+
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+
+				while (!stopping_ && generation_ == generation) {
+					startCondition_.wait(lock);
+				}
+
+				if (stopping_) {
+					return;
+				}
+
+				generation = generation_;
+			}
+
+			work(threadNo);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+
+				if (--numBusyThreads_ == 0) {
+					doneCondition_.notify_one();
+				}
+			}
+		}
+	}
+
+	bool ThreadPool::stealChunk(size_t threadNo)
+	{
+		for (size_t i = 1; i < numThreads_; ++i) {
+			Range &victim = ranges_[(threadNo + i) % numThreads_];
+			unsigned long long items = victim.items.load(std::memory_order_acquire);
+			size_t begin;
+			size_t end;
+			unpackRange(items, begin, end);
+
+			while (begin < end) {
+				/* Take the back half, or the last item. */
+				const size_t middle = begin + (end - begin) / 2;
+
+				if (victim.items.compare_exchange_weak(items, packRange(begin, middle), std::memory_order_acq_rel)) {
+					/* Only this thread writes its own range while it is empty. */
+					ranges_[threadNo].items.store(packRange(middle, end), std::memory_order_release);
+					return true;
+				}
+
+				unpackRange(items, begin, end);
+			}
+		}
+
+		return false;
+	}
+
+	bool ThreadPool::takeChunk(size_t threadNo, size_t &begin, size_t &end)
+	{
+		Range &range = ranges_[threadNo];
+		unsigned long long items = range.items.load(std::memory_order_acquire);
+		unpackRange(items, begin, end);
+
+		while (begin < end) {
+			/* Chunks shrink as the range drains, so that stealing can balance the tail. */
+			const size_t chunkSize = std::min(end - begin, std::max(minChunkSize_, (end - begin) / CHUNK_DIVISOR));
+
+			if (range.items.compare_exchange_weak(items, packRange(begin + chunkSize, end), std::memory_order_acq_rel)) {
+				end = begin + chunkSize;
+				return true;
+			}
+
+			unpackRange(items, begin, end);
+		}
+
+		return false;
+	}
+
+	void ThreadPool::work(size_t threadNo)
+	{
+		size_t begin;
+		size_t end;
+
+		do {
+			while (takeChunk(threadNo, begin, end)) {
+				task_->run(begin, end, threadNo);
+			}
+		}
+		while (stealChunk(threadNo));
+	}
+}
@@ -0,0 +1,138 @@
+/*
+ * ThreadPool.h
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef RVO_THREAD_POOL_H_
+#define RVO_THREAD_POOL_H_
+
+/**
+ * \file       ThreadPool.h
+ * \brief      Contains the ThreadPool class.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RVO {
+	/**
+	 * \brief      A persistent pool of worker threads that process ranges of
+	 *             items with work stealing.
+	 *
+	 * Each thread starts with an equal share of the items and takes chunks
+	 * from the front of its share, with chunks that shrink as the share
+	 * drains. A thread that runs out steals the back half of the remaining
+	 * share of another thread, so that threads that drew expensive items are
+	 * relieved by threads that drew cheap ones.
+	 */
+	class ThreadPool {
+	public:
+		/**
+		 * \brief      Defines the work done on a range of items.
+		 */
+		class Task {
+		public:
+			/**
+			 * \brief      Destroys this task instance.
+			 */
+			virtual ~Task() { }
+
+			/**
+			 * \brief      Processes a range of items.
+			 * \param      begin           The first item of the range.
+			 * \param      end             One past the last item of the range.
+			 * \param      threadNo        The number of the thread processing
+			 *                             the range, less than the number of
+			 *                             threads of the pool.
+			 */
+			virtual void run(size_t begin, size_t end, size_t threadNo) = 0;
+		};
+
+		/**
+		 * \brief      Constructs a thread pool and starts its worker threads.
+		 * \param      numThreads      The number of threads, including the
+		 *                             thread calling run, or zero for the
+		 *                             number of hardware threads.
+		 */
+		explicit ThreadPool(size_t numThreads);
+
+		/**
+		 * \brief      Stops the worker threads and destroys this thread pool.
+		 */
+		~ThreadPool();
+
+		/**
+		 * \brief      Returns the number of threads of this thread pool.
+		 * \return     The number of threads, including the thread calling run.
+		 */
+		size_t getNumThreads() const;
+
+		/**
+		 * \brief      Processes the specified number of items with the
+		 *             specified task and returns when all items are processed.
+		 * \param      task            The task processing the items.
+		 * \param      numItems        The number of items. Must be less than
+		 *                             2<sup>32</sup>.
+		 * \param      minChunkSize    The minimum number of items taken at once.
+		 */
+		void run(Task &task, size_t numItems, size_t minChunkSize);
+
+	private:
+		/**
+		 * \brief      Defines the remaining items of a thread, packed as the
+		 *             first item in the upper and one past the last item in the
+		 *             lower 32 bits, on a cache line of its own.
+		 */
+		class Range {
+		public:
+			std::atomic<unsigned long long> items;
+			char padding[64 - sizeof(std::atomic<unsigned long long>)];
+		};
+
+		ThreadPool(const ThreadPool &other);
+		ThreadPool &operator=(const ThreadPool &other);
+
+		void runWorker(size_t threadNo);
+
+		bool stealChunk(size_t threadNo);
+
+		bool takeChunk(size_t threadNo, size_t &begin, size_t &end);
+
+		void work(size_t threadNo);
+
+		std::condition_variable doneCondition_;
+		size_t generation_;
+		size_t minChunkSize_;
+		std::mutex mutex_;
+		size_t numBusyThreads_;
+		size_t numThreads_;
+		Range *ranges_;
+		std::condition_variable startCondition_;
+		bool stopping_;
+		Task *task_;
+		std::vector<std::thread> threads_;
+
+		static const size_t CHUNK_DIVISOR = 8;
+	};
+}
+
+#endif /* RVO_THREAD_POOL_H_ */
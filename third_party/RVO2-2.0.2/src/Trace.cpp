@@ -0,0 +1,132 @@
+/*
+ * Trace.cpp
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace RVO {
+	namespace {
+		struct TraceEvent {
+			const char *name;
+			unsigned long long begin;
+			unsigned long long end;
+		};
+
+		/* Written by its thread only, except for written, which belongs to Trace::write. */
+		struct TraceBuffer {
+			TraceEvent events[Trace::BUFFER_SIZE];
+			std::atomic<unsigned long long> count;
+			std::atomic<const char *> name;
+			unsigned long long written;
+		};
+
+		std::mutex traceMutex;
+		std::vector<TraceBuffer *> traceBuffers;
+		const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+		thread_local TraceBuffer *threadTraceBuffer = NULL;
+
+		/* Buffers outlive their threads, so that their last events are still written. */
+		TraceBuffer *getTraceBuffer()
+		{
+			if (threadTraceBuffer == NULL) {
+				threadTraceBuffer = new TraceBuffer();
+				threadTraceBuffer->count.store(0);
+				threadTraceBuffer->name.store(NULL);
+				threadTraceBuffer->written = 0;
+
+				std::lock_guard<std::mutex> lock(traceMutex);
+				traceBuffers.push_back(threadTraceBuffer);
+			}
+
+			return threadTraceBuffer;
+		}
+	}
+
+	unsigned long long Trace::now()
+	{
+		return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count());
+	}
+
+	void Trace::record(const char *name, unsigned long long begin, unsigned long long end)
+	{
+		TraceBuffer *const buffer = getTraceBuffer();
+		const unsigned long long count = buffer->count.load(std::memory_order_relaxed);
+
+		TraceEvent &event = buffer->events[count % BUFFER_SIZE];
+		event.name = name;
+		event.begin = begin;
+		event.end = end;
+
+		buffer->count.store(count + 1, std::memory_order_release);
+	}
+
+	void Trace::setThreadName(const char *name)
+	{
+		getTraceBuffer()->name.store(name);
+	}
+
+	bool Trace::write(const char *filename)
+	{
+		std::FILE *const file = std::fopen(filename, "w");
+
+		if (file == NULL) {
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(traceMutex);
+
+		std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+		const char *separator = "";
+
+		for (size_t i = 0; i < traceBuffers.size(); ++i) {
+			TraceBuffer *const buffer = traceBuffers[i];
+			const char *const threadName = buffer->name.load();
+
+			if (threadName != NULL) {
+				std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}", separator, static_cast<unsigned long>(i), threadName);
+				separator = ",\n";
+			}
+
+			const unsigned long long count = buffer->count.load(std::memory_order_acquire);
+			const unsigned long long first = std::max(buffer->written, count > BUFFER_SIZE ? count - BUFFER_SIZE : 0ull);
+
+			for (unsigned long long j = first; j < count; ++j) {
+				const TraceEvent &event = buffer->events[j % BUFFER_SIZE];
+				std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}", separator, event.name, static_cast<unsigned long>(i), event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+				separator = ",\n";
+			}
+
+			buffer->written = count;
+		}
+
+		std::fprintf(file, "\n]}\n");
+
+		return std::fclose(file) == 0;
+	}
+}
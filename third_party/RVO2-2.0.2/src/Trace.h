@@ -0,0 +1,149 @@
+/*
+ * Trace.h
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+
+#ifndef RVO_TRACE_H_
+#define RVO_TRACE_H_
+
+/**
+ * \file       Trace.h
+ * \brief      Contains the Trace and TraceScope classes.
+ */
+
+#include <cstddef>
+
+namespace RVO {
+	/**
+	 * \brief      Records timed events in per-thread buffers and writes them
+	 *             as a Chrome trace, to be opened in chrome://tracing or
+	 *             Perfetto.
+	 *
+	 * Recording takes no locks: every thread appends to a ring buffer of its
+	 * own, which is registered on the first event of the thread. When a
+	 * thread records more events than a buffer holds between two writes, the
+	 * oldest are dropped.
+	 */
+	class Trace {
+	public:
+		/**
+		 * \brief      Returns the current time of the trace clock.
+		 * \return     The time in nanoseconds.
+		 */
+		static unsigned long long now();
+
+		/**
+		 * \brief      Records an event of the calling thread.
+		 * \param      name            The name of the event. Must remain valid
+		 *                             until the trace is written, as for
+		 *                             string literals.
+		 * \param      begin           The start time of the event.
+		 * \param      end             The end time of the event.
+		 */
+		static void record(const char *name, unsigned long long begin, unsigned long long end);
+
+		/**
+		 * \brief      Names the calling thread in the written trace.
+		 * \param      name            The name of the thread. Must remain
+		 *                             valid until the trace is written.
+		 */
+		static void setThreadName(const char *name);
+
+		/**
+		 * \brief      Writes the events recorded since the last write to a
+		 *             Chrome trace JSON file.
+		 * \param      filename        The name of the file.
+		 * \return     True if the file was written.
+		 *
+		 * Events of threads that record while the trace is written may be
+		 * torn, so this is best called between simulation steps.
+		 */
+		static bool write(const char *filename);
+
+		/**
+		 * \brief      The number of events each thread buffers.
+		 */
+		static const size_t BUFFER_SIZE = 1 << 16;
+	};
+
+	/**
+	 * \brief      Records an event lasting from its construction to its
+	 *             destruction or an earlier call to end.
+	 */
+	class TraceScope {
+	public:
+		/**
+		 * \brief      Starts an event.
+		 * \param      name            The name of the event.
+		 */
+		explicit TraceScope(const char *name) : begin_(Trace::now()), name_(name) { }
+
+		/**
+		 * \brief      Ends the event unless it was ended already.
+		 */
+		~TraceScope() { end(); }
+
+		/**
+		 * \brief      Ends and records the event.
+		 */
+		void end()
+		{
+			if (name_ != NULL) {
+				Trace::record(name_, begin_, Trace::now());
+				name_ = NULL;
+			}
+		}
+
+	private:
+		TraceScope(const TraceScope &other);
+		TraceScope &operator=(const TraceScope &other);
+
+		unsigned long long begin_;
+		const char *name_;
+	};
+}
+
+/**
+ * \brief      Records the rest of the enclosing scope as an event when built
+ *             with RVO_TRACING.
+ */
+#define RVO_TRACE_SCOPE(name) RVO_TRACE_BEGIN(RVO_TRACE_CONCAT(rvoTraceScope, __LINE__), name)
+
+#if RVO_TRACING
+#define RVO_TRACE_CONCAT_(a, b) a##b
+#define RVO_TRACE_CONCAT(a, b) RVO_TRACE_CONCAT_(a, b)
+
+/**
+ * \brief      Starts an event named var that lasts until RVO_TRACE_END(var)
+ *             or the end of the scope when built with RVO_TRACING.
+ */
+#define RVO_TRACE_BEGIN(var, name) ::RVO::TraceScope var(name)
+
+/**
+ * \brief      Ends the event started by RVO_TRACE_BEGIN(var).
+ */
+#define RVO_TRACE_END(var) var.end()
+#else
+#define RVO_TRACE_CONCAT(a, b)
+#define RVO_TRACE_BEGIN(var, name) static_cast<void>(0)
+#define RVO_TRACE_END(var) static_cast<void>(0)
+#endif
+
+#endif /* RVO_TRACE_H_ */
@@ -0,0 +1,103 @@
+/*
+ * VisibilityCache.cpp
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "VisibilityCache.h"
+
+#include <cmath>
+
+#include "RVOSimulator.h"
+
+namespace RVO {
+	VisibilityCache::VisibilityCache(const RVOSimulator *sim, const std::vector<Vector2> &targets, float radius, float cellSize) : cellSize_(cellSize), radius_(radius), sim_(sim), targets_(targets) { }
+
+	void VisibilityCache::clear()
+	{
+		cells_.clear();
+		visible_.clear();
+	}
+
+	size_t VisibilityCache::getNumCells() const
+	{
+		return cells_.size();
+	}
+
+	size_t VisibilityCache::getNumTargets() const
+	{
+		return targets_.size();
+	}
+
+	const Vector2 &VisibilityCache::getTarget(size_t targetNo) const
+	{
+		return targets_[targetNo];
+	}
+
+	std::pair<int, int> VisibilityCache::getCell(const Vector2 &point) const
+	{
+		return std::make_pair(static_cast<int>(std::floor(point.x() / cellSize_)), static_cast<int>(std::floor(point.y() / cellSize_)));
+	}
+
+	void VisibilityCache::prepare(const std::vector<Vector2> &points)
+	{
+		std::vector<std::pair<int, int> > newCells;
+
+		for (size_t i = 0; i < points.size(); ++i) {
+			const std::pair<int, int> cell = getCell(points[i]);
+
+			if (cells_.find(cell) == cells_.end()) {
+				cells_.insert(std::make_pair(cell, cells_.size()));
+				newCells.push_back(cell);
+			}
+		}
+
+		if (newCells.empty()) {
+			return;
+		}
+
+		std::vector<Vector2> points1;
+		std::vector<Vector2> points2;
+		points1.reserve(newCells.size() * targets_.size());
+		points2.reserve(newCells.size() * targets_.size());
+
+		for (size_t i = 0; i < newCells.size(); ++i) {
+			const Vector2 center((newCells[i].first + 0.5f) * cellSize_, (newCells[i].second + 0.5f) * cellSize_);
+
+			for (size_t j = 0; j < targets_.size(); ++j) {
+				points1.push_back(center);
+				points2.push_back(targets_[j]);
+			}
+		}
+
+		std::vector<bool> visible;
+		sim_->queryVisibility(points1, points2, visible, radius_ + 0.5f * std::sqrt(2.0f) * cellSize_);
+
+		visible_.insert(visible_.end(), visible.begin(), visible.end());
+	}
+
+	bool VisibilityCache::queryVisibility(const Vector2 &point, size_t targetNo) const
+	{
+		const std::map<std::pair<int, int>, size_t>::const_iterator cell = cells_.find(getCell(point));
+
+		if (cell != cells_.end() && visible_[cell->second * targets_.size() + targetNo]) {
+			return true;
+		}
+
+		return sim_->queryVisibility(point, targets_[targetNo], radius_);
+	}
+}
@@ -0,0 +1,127 @@
+/*
+ * VisibilityCache.h
+ * RVO2 Library
+ *
+ * Copyright 2026 The collision_avoidance authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef RVO_VISIBILITY_CACHE_H_
+#define RVO_VISIBILITY_CACHE_H_
+
+/**
+ * \file       VisibilityCache.h
+ * \brief      Contains the VisibilityCache class.
+ */
+
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Vector2.h"
+
+namespace RVO {
+	class RVOSimulator;
+
+	/**
+	 * \brief      Caches the visibility between a fixed set of target points,
+	 *             such as the vertices of a roadmap, and the cells of a grid.
+	 *
+	 * A target is recorded as visible from a cell when it is visible from the
+	 * center of the cell with the query radius enlarged by half the diagonal
+	 * of the cell, in which case it is visible from any point in the cell.
+	 * Queries that cannot be answered this way fall back to
+	 * RVOSimulator::queryVisibility. A target reported as visible therefore
+	 * always keeps the query radius clear of the obstacles, although the
+	 * cache occasionally reports a target as visible where the stricter test
+	 * of RVOSimulator::queryVisibility would not.
+	 */
+	class VisibilityCache {
+	public:
+		/**
+		 * \brief      Constructs a visibility cache.
+		 * \param      sim             The simulator instance whose processed
+		 *                             obstacles are queried.
+		 * \param      targets         The two-dimensional target points.
+		 * \param      radius          The minimal distance between the line
+		 *                             connecting a point and a target and the
+		 *                             obstacles in order for them to be mutually
+		 *                             visible. Must be non-negative.
+		 * \param      cellSize        The size of the grid cells. Must be
+		 *                             positive.
+		 */
+		VisibilityCache(const RVOSimulator *sim,
+						const std::vector<Vector2> &targets, float radius,
+						float cellSize);
+
+		/**
+		 * \brief      Discards the cached cells, e.g. after the obstacles have
+		 *             changed.
+		 */
+		void clear();
+
+		/**
+		 * \brief      Returns the count of cached cells.
+		 * \return     The count of cached cells.
+		 */
+		size_t getNumCells() const;
+
+		/**
+		 * \brief      Returns the count of target points.
+		 * \return     The count of target points.
+		 */
+		size_t getNumTargets() const;
+
+		/**
+		 * \brief      Returns the two-dimensional position of a target point.
+		 * \param      targetNo        The number of the target point.
+		 * \return     The two-dimensional position of the target point.
+		 */
+		const Vector2 &getTarget(size_t targetNo) const;
+
+		/**
+		 * \brief      Computes the cached visibility for the cells containing
+		 *             the specified points that have not been cached yet.
+		 * \param      points          The two-dimensional points, typically the
+		 *                             positions of the agents.
+		 */
+		void prepare(const std::vector<Vector2> &points);
+
+		/**
+		 * \brief      Performs a visibility query between the specified point
+		 *             and target point.
+		 * \param      point           The two-dimensional point of the query.
+		 * \param      targetNo        The number of the target point.
+		 * \return     A boolean specifying whether the point and the target are
+		 *             mutually visible.
+		 * \note       Safe to call concurrently, but not concurrently with
+		 *             prepare or clear.
+		 */
+		bool queryVisibility(const Vector2 &point, size_t targetNo) const;
+
+	private:
+		std::pair<int, int> getCell(const Vector2 &point) const;
+
+		std::map<std::pair<int, int>, size_t> cells_;
+		float cellSize_;
+		float radius_;
+		const RVOSimulator *sim_;
+		std::vector<Vector2> targets_;
+		std::vector<char> visible_;
+	};
+}
+
+#endif /* RVO_VISIBILITY_CACHE_H_ */
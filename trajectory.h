@@ -0,0 +1,639 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <RVOSimulator.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRAJECTORY_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Binary trajectory format.
+ *
+ * A file starts with a header followed by the raw bytes of the recording
+ * application's options, whose layout is identified by the version the
+ * application gives them. Every recorded step is a frame: a frame header
+ * followed either by absolute agent states (keyframe) or by quantized deltas
+ * relative to the previous frame. A keyframe is written at a fixed interval,
+ * whenever the number of agents changes and whenever a delta does not fit.
+ * The file ends with an index holding the offset of every frame and of the
+ * keyframe it depends on, followed by a footer pointing at the index. Steps
+ * the recorder had to drop are missing from the frames and counted in the
+ * footer.
+ *
+ * All records are 8 byte aligned so that a mapped file can be read in place.
+ */
+struct Trajectory
+{
+  static constexpr std::array<char, 4> file_magic{ 'R', 'V', 'O', 'T' };
+  static constexpr std::array<char, 4> index_magic{ 'R', 'V', 'O', 'I' };
+  static constexpr uint32_t format_version{ 1 };
+
+  enum frame_type_t : uint32_t
+  {
+    KEYFRAME,
+    DELTA,
+  };
+
+  struct file_header_t
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t keyframe_interval;
+    /* Size of one delta unit in meters for positions, m/s for velocities. */
+    float quantum;
+    /* Followed by the options, padded to 8 bytes. */
+    uint32_t options_size;
+    /* Zero in files written before the options were versioned. */
+    uint32_t options_version;
+  };
+
+  struct frame_header_t
+  {
+    uint32_t type;
+    uint32_t num_agents;
+    uint64_t step;
+    double time;
+  };
+
+  struct agent_state_t
+  {
+    float position[2];
+    float velocity[2];
+  };
+
+  struct agent_delta_t
+  {
+    int16_t position[2];
+    int16_t velocity[2];
+  };
+
+  struct index_entry_t
+  {
+    uint64_t offset;
+    uint64_t keyframe;
+  };
+
+  struct footer_t
+  {
+    uint64_t index_offset;
+    uint64_t num_frames;
+    char magic[4];
+    /* Saturated at the largest count that fits. */
+    uint32_t dropped_frames;
+  };
+
+  static constexpr uint64_t padded(uint64_t size) { return (size + 7) & ~7ull; }
+
+  /* Apply a delta in the order used by both the writer and the reader. */
+  static void apply(agent_state_t& state, const agent_delta_t& delta, float q)
+  {
+    for (int k = 0; k < 2; ++k) {
+      state.position[k] += delta.position[k] * q;
+      state.velocity[k] += delta.velocity[k] * q;
+    }
+  }
+};
+
+static_assert(sizeof(Trajectory::file_header_t) == 24);
+static_assert(sizeof(Trajectory::frame_header_t) == 24);
+static_assert(sizeof(Trajectory::agent_state_t) == 16);
+static_assert(sizeof(Trajectory::agent_delta_t) == 8);
+
+/*
+ * Records simulator steps to a trajectory file. record() only copies the
+ * agent states into a recycled buffer; encoding and file writes happen on a
+ * background thread so that recording does not stall the simulation. When the
+ * disk falls behind and max_pending frames wait for the thread, further steps
+ * are dropped and counted instead of growing the queue without bound. Without
+ * thread support (Emscripten) frames are encoded and written synchronously.
+ */
+class TrajectoryWriter
+{
+public:
+  TrajectoryWriter() = default;
+  TrajectoryWriter(const TrajectoryWriter&) = delete;
+  TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+  ~TrajectoryWriter() { close(); }
+
+  bool open(const char* path,
+            const void* options,
+            uint32_t options_size,
+            uint32_t options_version,
+            uint32_t keyframe_interval = 64,
+            float quantum = 1.0f / 1024,
+            size_t max_pending = 64)
+  {
+    close();
+
+    file = std::fopen(path, "wb");
+    if (!file) {
+      std::printf("Failed to open trajectory file %s\n", path);
+      return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    Trajectory::file_header_t header{};
+    std::memcpy(header.magic, Trajectory::file_magic.data(), 4);
+    header.version = Trajectory::format_version;
+    header.keyframe_interval = std::max(keyframe_interval, 1u);
+    header.quantum = quantum;
+    header.options_size = options_size;
+    header.options_version = options_version;
+    this->keyframe_interval = header.keyframe_interval;
+    this->quantum = quantum;
+    this->max_pending = std::max<size_t>(max_pending, 1);
+    offset = 0;
+    written = 0;
+    failed = false;
+    write(&header, sizeof(header));
+    write(options, options_size);
+    pad();
+
+    index.clear();
+    previous.clear();
+    deltas.clear();
+    frames_since_keyframe = 0;
+    num_frames = 0;
+    num_dropped = 0;
+    last_keyframe = 0;
+
+#if !__EMSCRIPTEN__
+    stopping = false;
+    worker = std::thread(&TrajectoryWriter::run, this);
+#endif
+    return true;
+  }
+
+  /* Capture the current agent states of the simulator as the next frame. */
+  void record(const RVO::RVOSimulator& simulator)
+  {
+    if (!file) {
+      return;
+    }
+
+#if !__EMSCRIPTEN__
+    /* Only this thread adds frames, so the queue cannot fill up meanwhile. */
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (pending.size() >= max_pending) {
+        ++num_frames;
+        ++num_dropped;
+        return;
+      }
+    }
+#endif
+
+    frame_t frame = acquire();
+    frame.step = num_frames++;
+    frame.time = simulator.getGlobalTime();
+    frame.agents.resize(simulator.getNumAgents());
+    for (size_t i = 0; i < frame.agents.size(); ++i) {
+      const auto& position = simulator.getAgentPosition(i);
+      const auto& velocity = simulator.getAgentVelocity(i);
+      frame.agents[i] = { { position.x(), position.y() },
+                          { velocity.x(), velocity.y() } };
+    }
+
+#if __EMSCRIPTEN__
+    encode(frame);
+    free_frames.emplace_back(std::move(frame));
+#else
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.emplace_back(std::move(frame));
+    }
+    condition.notify_one();
+#endif
+  }
+
+  /* Flush the pending frames, write the index and close the file. */
+  void close()
+  {
+    if (!file) {
+      return;
+    }
+
+#if !__EMSCRIPTEN__
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    condition.notify_one();
+    worker.join();
+#endif
+
+    Trajectory::footer_t footer{};
+    footer.index_offset = offset;
+    footer.num_frames = index.size();
+    std::memcpy(footer.magic, Trajectory::index_magic.data(), 4);
+    footer.dropped_frames = static_cast<uint32_t>(
+      std::min<uint64_t>(num_dropped, std::numeric_limits<uint32_t>::max()));
+    write(index.data(), index.size() * sizeof(Trajectory::index_entry_t));
+    write(&footer, sizeof(footer));
+
+    if (std::fclose(file) != 0 || failed) {
+      std::printf("Failed to write trajectory file\n");
+    }
+    if (num_dropped > 0) {
+      std::printf("Dropped %llu trajectory frames the disk could not keep "
+                  "up with\n",
+                  static_cast<unsigned long long>(num_dropped));
+    }
+    file = nullptr;
+  }
+
+  bool is_open() const { return file != nullptr; }
+
+  /* Frames captured so far, including the ones not yet written. */
+  uint64_t frames() const { return num_frames - num_dropped; }
+
+  /* Steps dropped so far because too many frames were pending. */
+  uint64_t dropped_frames() const { return num_dropped; }
+
+  /* Bytes written so far by the encoder. */
+  uint64_t bytes_written() const { return written; }
+
+private:
+  struct frame_t
+  {
+    uint64_t step;
+    double time;
+    std::vector<Trajectory::agent_state_t> agents;
+  };
+
+  frame_t acquire()
+  {
+#if !__EMSCRIPTEN__
+    std::lock_guard<std::mutex> lock(mutex);
+#endif
+    if (free_frames.empty()) {
+      return {};
+    }
+    frame_t frame = std::move(free_frames.back());
+    free_frames.pop_back();
+    return frame;
+  }
+
+#if !__EMSCRIPTEN__
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      condition.wait(lock, [this] { return stopping || !pending.empty(); });
+      if (pending.empty()) {
+        break;
+      }
+      frame_t frame = std::move(pending.front());
+      pending.pop_front();
+
+      lock.unlock();
+      encode(frame);
+      lock.lock();
+
+      free_frames.emplace_back(std::move(frame));
+    }
+  }
+#endif
+
+  void encode(const frame_t& frame)
+  {
+    const uint32_t num_agents = static_cast<uint32_t>(frame.agents.size());
+    bool keyframe = index.empty() || previous.size() != num_agents ||
+                    frames_since_keyframe >= keyframe_interval;
+
+    if (!keyframe) {
+      deltas.resize(num_agents);
+      constexpr float limit = std::numeric_limits<int16_t>::max();
+      for (uint32_t i = 0; i < num_agents && !keyframe; ++i) {
+        const auto& current = frame.agents[i];
+        const auto& before = previous[i];
+        for (int k = 0; k < 2; ++k) {
+          const float position =
+            std::round((current.position[k] - before.position[k]) / quantum);
+          const float velocity =
+            std::round((current.velocity[k] - before.velocity[k]) / quantum);
+          if (!(std::fabs(position) <= limit && std::fabs(velocity) <= limit)) {
+            keyframe = true;
+            break;
+          }
+          deltas[i].position[k] = static_cast<int16_t>(position);
+          deltas[i].velocity[k] = static_cast<int16_t>(velocity);
+        }
+      }
+    }
+
+    Trajectory::frame_header_t header{};
+    header.type = keyframe ? Trajectory::KEYFRAME : Trajectory::DELTA;
+    header.num_agents = num_agents;
+    header.step = frame.step;
+    header.time = frame.time;
+
+    if (keyframe) {
+      last_keyframe = index.size();
+      frames_since_keyframe = 0;
+    }
+    index.push_back({ offset, last_keyframe });
+    ++frames_since_keyframe;
+
+    write(&header, sizeof(header));
+    if (keyframe) {
+      previous = frame.agents;
+      write(previous.data(), num_agents * sizeof(Trajectory::agent_state_t));
+    } else {
+      /* Track the decoded state so that quantization errors do not drift. */
+      for (uint32_t i = 0; i < num_agents; ++i) {
+        Trajectory::apply(previous[i], deltas[i], quantum);
+      }
+      write(deltas.data(), num_agents * sizeof(Trajectory::agent_delta_t));
+    }
+    written = offset;
+  }
+
+  void write(const void* data, size_t size)
+  {
+    if (size > 0 && std::fwrite(data, 1, size, file) != size) {
+      failed = true;
+    }
+    offset += size;
+  }
+
+  void pad()
+  {
+    static constexpr char zeros[8] = {};
+    write(zeros, Trajectory::padded(offset) - offset);
+  }
+
+  std::FILE* file{ nullptr };
+  bool failed{ false };
+  uint32_t keyframe_interval{ 64 };
+  float quantum{ 1.0f / 1024 };
+  uint64_t offset{ 0 };
+  size_t max_pending{ 64 };
+  uint64_t num_frames{ 0 };
+  uint64_t num_dropped{ 0 };
+  std::atomic<uint64_t> written{ 0 };
+
+  /* Encoder state, owned by the worker while the file is open. */
+  std::vector<Trajectory::index_entry_t> index;
+  std::vector<Trajectory::agent_state_t> previous;
+  std::vector<Trajectory::agent_delta_t> deltas;
+  uint64_t frames_since_keyframe{ 0 };
+  uint64_t last_keyframe{ 0 };
+
+  std::vector<frame_t> free_frames;
+#if !__EMSCRIPTEN__
+  std::deque<frame_t> pending;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::thread worker;
+  bool stopping{ false };
+#endif
+};
+
+/*
+ * Reads a trajectory file for replay. The file is memory mapped when the
+ * platform allows it and read into memory otherwise. Keyframes are returned
+ * in place; delta frames are decoded from their keyframe into a buffer, so
+ * seeking to any frame costs at most one keyframe interval of decoding.
+ */
+class TrajectoryReader
+{
+public:
+  static constexpr uint64_t npos = std::numeric_limits<uint64_t>::max();
+
+  TrajectoryReader() = default;
+  TrajectoryReader(const TrajectoryReader&) = delete;
+  TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+  ~TrajectoryReader() { close(); }
+
+  bool open(const char* path)
+  {
+    close();
+
+#if TRAJECTORY_MMAP
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      std::printf("Failed to open trajectory file %s\n", path);
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* mapping =
+        mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED) {
+        data = static_cast<const char*>(mapping);
+        size = st.st_size;
+        mapped = true;
+      }
+    }
+    ::close(fd);
+#endif
+
+    if (!data) {
+      std::FILE* file = std::fopen(path, "rb");
+      if (!file) {
+        std::printf("Failed to open trajectory file %s\n", path);
+        return false;
+      }
+      std::fseek(file, 0, SEEK_END);
+      long length = std::ftell(file);
+      std::fseek(file, 0, SEEK_SET);
+      if (length > 0) {
+        /* Stored as 8 byte words to keep the records aligned. */
+        buffer.resize((length + 7) / 8);
+        if (std::fread(buffer.data(), 1, length, file) ==
+            static_cast<size_t>(length)) {
+          data = reinterpret_cast<const char*>(buffer.data());
+          size = length;
+        }
+      }
+      std::fclose(file);
+    }
+
+    if (!data || !validate()) {
+      std::printf("Invalid trajectory file %s\n", path);
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close()
+  {
+#if TRAJECTORY_MMAP
+    if (mapped) {
+      munmap(const_cast<char*>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+    mapped = false;
+    buffer.clear();
+    buffer.shrink_to_fit();
+    file_header = nullptr;
+    index = nullptr;
+    num_frames = 0;
+    dropped = 0;
+    decoded.clear();
+    decoded_frame = npos;
+  }
+
+  bool is_open() const { return data != nullptr; }
+
+  uint64_t frames() const { return num_frames; }
+
+  /* Steps the recorder dropped, which are missing from the frames. */
+  uint32_t dropped_frames() const { return dropped; }
+
+  /* Raw bytes of the options stored by the recording application. */
+  const void* options() const { return file_header + 1; }
+
+  uint32_t options_size() const { return file_header->options_size; }
+
+  uint32_t options_version() const { return file_header->options_version; }
+
+  const Trajectory::frame_header_t& header(uint64_t frame) const
+  {
+    return *reinterpret_cast<const Trajectory::frame_header_t*>(
+      data + index[frame].offset);
+  }
+
+  /*
+   * Agent states of a frame, header(frame).num_agents long. The pointer is
+   * valid until the next call or until the file is closed.
+   */
+  const Trajectory::agent_state_t* states(uint64_t frame)
+  {
+    if (frame >= num_frames) {
+      return nullptr;
+    }
+    const auto& frame_header = header(frame);
+    if (frame_header.type == Trajectory::KEYFRAME) {
+      return reinterpret_cast<const Trajectory::agent_state_t*>(&frame_header +
+                                                                1);
+    }
+
+    const uint64_t keyframe = index[frame].keyframe;
+    if (decoded_frame == npos || decoded_frame < keyframe ||
+        decoded_frame > frame) {
+      const auto* begin = states(keyframe);
+      decoded.assign(begin, begin + header(keyframe).num_agents);
+      decoded_frame = keyframe;
+    }
+    const float quantum = file_header->quantum;
+    for (uint64_t f = decoded_frame + 1; f <= frame; ++f) {
+      const auto* deltas =
+        reinterpret_cast<const Trajectory::agent_delta_t*>(&header(f) + 1);
+      for (size_t i = 0; i < decoded.size(); ++i) {
+        Trajectory::apply(decoded[i], deltas[i], quantum);
+      }
+    }
+    decoded_frame = frame;
+    return decoded.data();
+  }
+
+  /* Last frame recorded at or before the given time. */
+  uint64_t find(double time) const
+  {
+    uint64_t first = 0;
+    uint64_t count = num_frames;
+    while (count > 0) {
+      uint64_t step = count / 2;
+      if (header(first + step).time <= time) {
+        first += step + 1;
+        count -= step + 1;
+      } else {
+        count = step;
+      }
+    }
+    return first > 0 ? first - 1 : 0;
+  }
+
+private:
+  bool validate()
+  {
+    if (size < sizeof(Trajectory::file_header_t) + sizeof(Trajectory::footer_t)) {
+      return false;
+    }
+    file_header = reinterpret_cast<const Trajectory::file_header_t*>(data);
+    if (std::memcmp(file_header->magic, Trajectory::file_magic.data(), 4) != 0 ||
+        file_header->version != Trajectory::format_version) {
+      return false;
+    }
+    const uint64_t frames_begin = Trajectory::padded(
+      sizeof(Trajectory::file_header_t) + file_header->options_size);
+
+    const auto* footer = reinterpret_cast<const Trajectory::footer_t*>(
+      data + size - sizeof(Trajectory::footer_t));
+    if (std::memcmp(footer->magic, Trajectory::index_magic.data(), 4) != 0 ||
+        footer->index_offset < frames_begin ||
+        footer->index_offset % 8 != 0 ||
+        (size - sizeof(Trajectory::footer_t) - footer->index_offset) /
+            sizeof(Trajectory::index_entry_t) !=
+          footer->num_frames) {
+      return false;
+    }
+    index = reinterpret_cast<const Trajectory::index_entry_t*>(
+      data + footer->index_offset);
+    num_frames = footer->num_frames;
+    dropped = footer->dropped_frames;
+
+    /* Check every record once so that states() can trust the file. */
+    for (uint64_t f = 0; f < num_frames; ++f) {
+      const uint64_t offset = index[f].offset;
+      if (offset < frames_begin || offset % 8 != 0 ||
+          offset + sizeof(Trajectory::frame_header_t) > footer->index_offset ||
+          index[f].keyframe > f) {
+        return false;
+      }
+      const auto& frame_header = header(f);
+      const bool keyframe = frame_header.type == Trajectory::KEYFRAME;
+      const uint64_t payload =
+        uint64_t(frame_header.num_agents) *
+        (keyframe ? sizeof(Trajectory::agent_state_t)
+                  : sizeof(Trajectory::agent_delta_t));
+      if (offset + sizeof(Trajectory::frame_header_t) + payload >
+          footer->index_offset) {
+        return false;
+      }
+      const auto& base = header(index[f].keyframe);
+      if (keyframe ? index[f].keyframe != f
+                   : (frame_header.type != Trajectory::DELTA ||
+                      base.type != Trajectory::KEYFRAME ||
+                      base.num_agents != frame_header.num_agents)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const char* data{ nullptr };
+  size_t size{ 0 };
+  bool mapped{ false };
+  std::vector<uint64_t> buffer;
+  const Trajectory::file_header_t* file_header{ nullptr };
+  const Trajectory::index_entry_t* index{ nullptr };
+  uint64_t num_frames{ 0 };
+  uint32_t dropped{ 0 };
+
+  std::vector<Trajectory::agent_state_t> decoded;
+  uint64_t decoded_frame{ npos };
+};